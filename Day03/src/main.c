@@ -7,76 +7,305 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <stdbool.h>
+#include <immintrin.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-uint64_t	pow_int(uint64_t num ,uint64_t exp)
+#define JOLT_MAX_DIGITS 256
+#define LIMB_DIGITS 9
+#define LIMB_BASE 1000000000UL
+#define N_LIMBS (JOLT_MAX_DIGITS / LIMB_DIGITS + 4)
+#define MAX_PENDING (1UL << 32)
+
+// Decimal big integer, base 1e9 limbs. Additions are carry-save: limbs are
+// summed independently and only normalised every MAX_PENDING additions.
+struct bignum
 {
-	uint64_t out = 1;
+	uint64_t	limbs[N_LIMBS];
+	uint64_t	pending;
+};
 
-	while (exp-- > 0)
-		out *= num;
+void	bignum_normalise(struct bignum *num)
+{
+	uint64_t	carry = 0;
 
-	return (out);
+	for (int32_t i = 0; i < N_LIMBS; i++)
+	{
+		num->limbs[i] += carry;
+		carry = num->limbs[i] / LIMB_BASE;
+		num->limbs[i] %= LIMB_BASE;
+	}
+	num->pending = 0;
 }
 
-uint64_t	get_joltage(char *line, int32_t n_digits)
+void	bignum_add_digits(struct bignum *num, const char *digits, int32_t n_digits)
 {
-	int32_t		*digits = calloc(n_digits, sizeof(uint32_t));
-	int32_t		line_len = strlen(line);
+	int32_t	limb = 0;
+
+	for (int32_t end = n_digits; end > 0; end -= LIMB_DIGITS, limb++)
+	{
+		int32_t		start = end > LIMB_DIGITS ? end - LIMB_DIGITS : 0;
+		uint64_t	value = 0;
+
+		for (int32_t i = start; i < end; i++)
+			value = value * 10 + (digits[i] - '0');
+		num->limbs[limb] += value;
+	}
+	if (++num->pending == MAX_PENDING)
+		bignum_normalise(num);
+}
+
+void	bignum_add(struct bignum *num, struct bignum *other)
+{
+	bignum_normalise(num);
+	bignum_normalise(other);
+	for (int32_t i = 0; i < N_LIMBS; i++)
+		num->limbs[i] += other->limbs[i];
+	bignum_normalise(num);
+}
+
+void	bignum_print(struct bignum *num)
+{
+	int32_t	top = N_LIMBS - 1;
+
+	bignum_normalise(num);
+	while (top > 0 && num->limbs[top] == 0)
+		top--;
+	printf("%lu", num->limbs[top]);
+	while (--top >= 0)
+		printf("%09lu", num->limbs[top]);
+}
+
+#ifdef __AVX2__
+uint8_t	hmax_epu8(__m256i vec)
+{
+	__m128i	half = _mm_max_epu8(_mm256_castsi256_si128(vec), _mm256_extracti128_si256(vec, 1));
+
+	half = _mm_max_epu8(half, _mm_srli_si128(half, 8));
+	half = _mm_max_epu8(half, _mm_srli_si128(half, 4));
+	half = _mm_max_epu8(half, _mm_srli_si128(half, 2));
+	half = _mm_max_epu8(half, _mm_srli_si128(half, 1));
+	return (_mm_cvtsi128_si32(half) & 0xff);
+}
+#endif
+
+// Index of the first occurrence of the largest digit in line[start, end)
+int32_t	find_max_digit(const char *line, int32_t start, int32_t end)
+{
+	int32_t	i = start;
+	uint8_t	max = '0';
+
+#ifdef __AVX2__
+	const __m256i	nines = _mm256_set1_epi8('9');
+	__m256i			vmax = _mm256_set1_epi8('0');
+
+	for (; i + 32 <= end; i += 32)
+	{
+		__m256i		block = _mm256_loadu_si256((const __m256i *)(line + i));
+		uint32_t	mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, nines));
+		if (mask != 0)
+			return (i + __builtin_ctz(mask));
+		vmax = _mm256_max_epu8(vmax, block);
+	}
+	max = hmax_epu8(vmax);
+#endif
+	for (int32_t j = i; j < end; j++)
+	{
+		if ((uint8_t)line[j] > max)
+			max = line[j];
+	}
+
+	i = start;
+#ifdef __AVX2__
+	const __m256i	target = _mm256_set1_epi8(max);
+
+	for (; i + 32 <= end; i += 32)
+	{
+		__m256i		block = _mm256_loadu_si256((const __m256i *)(line + i));
+		uint32_t	mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, target));
+		if (mask != 0)
+			return (i + __builtin_ctz(mask));
+	}
+#endif
+	while (i < end && (uint8_t)line[i] != max)
+		i++;
+	return (i);
+}
+
+bool	select_digits(const char *line, int32_t line_len, int32_t n_digits, char *digits)
+{
+	if (line_len < n_digits)
+		return (false);
 
-	for (int32_t i = 0; i < n_digits; i++)
-		digits[i] = -1;
+	int32_t		dig_idx = 0;
+	int32_t		last_idx = -1;
+	for (int32_t i = n_digits; i > 0; i--, dig_idx++)
+	{
+		last_idx = find_max_digit(line, last_idx + 1, line_len + 1 - i);
+		digits[dig_idx] = line[last_idx];
+	}
+	digits[n_digits] = '\0';
+	return (true);
+}
 
-	if (line[line_len - 1] == '\n')
+void	get_joltage(char *line, int32_t n_digits, struct bignum *total)
+{
+	int32_t		line_len = strlen(line);
+	char		digits[JOLT_MAX_DIGITS + 1];
+
+	if (line_len > 0 && line[line_len - 1] == '\n')
 	{
 		line[line_len - 1] = '\0';
 		line_len--;
 	}
+	if (!select_digits(line, line_len, n_digits, digits))
+		return ;
 
-	int32_t	dig_idx = 0;
-	int32_t	last_idx = -1;
-	for (int32_t i = n_digits; i > 0; i--, dig_idx++)
+	bignum_add_digits(total, digits, n_digits);
+	printf("joltage: %12s %s\n", digits, line);
+}
+
+struct chunk
+{
+	pthread_t		thread;
+	const char		*start;
+	const char		*end;
+	int32_t			n_digits;
+	struct bignum	total;
+};
+
+void	*chunk_routine(void *arg)
+{
+	struct chunk	*chunk = arg;
+	const char		*line = chunk->start;
+	char			digits[JOLT_MAX_DIGITS + 1];
+	// Accumulated on the stack so per-line writes never share a cache line
+	// with the neighbouring chunks
+	struct bignum	total = {};
+
+	while (line < chunk->end)
 	{
-		for (int32_t j = last_idx + 1; j < line_len + 1 - i; j++)
+		const char	*nl = memchr(line, '\n', chunk->end - line);
+		if (nl == NULL)
+			nl = chunk->end;
+		if (select_digits(line, nl - line, chunk->n_digits, digits))
+			bignum_add_digits(&total, digits, chunk->n_digits);
+		line = nl + 1;
+	}
+	chunk->total = total;
+	return (NULL);
+}
+
+// mmaps the file and splits it on newline boundaries into one chunk per
+// thread, then reduces the per-thread totals.
+int	solve_parallel(const char *path, int32_t n_digits, int64_t n_threads, struct bignum *total)
+{
+	int	fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return (printf("Failed to open file\n"), 1);
+
+	struct stat	st;
+	if (fstat(fd, &st) == -1)
+		return (close(fd), printf("Failed to stat file\n"), 1);
+	if (st.st_size == 0)
+		return (close(fd), 0);
+
+	const char	*data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return (printf("Failed to map file\n"), 1);
+	madvise((void *)data, st.st_size, MADV_SEQUENTIAL);
+
+	const char		*end = data + st.st_size;
+	const char		*start = data;
+	struct chunk	*chunks = calloc(n_threads, sizeof(struct chunk));
+	int64_t			n_chunks = 0;
+	int				status = 0;
+
+	if (chunks == NULL)
+		return (munmap((void *)data, st.st_size), printf("Too many threads\n"), 1);
+
+	for (int64_t i = 0; i < n_threads && start < end; i++)
+	{
+		const char	*split = data + st.st_size * (i + 1) / n_threads;
+		if (split < start)
+			split = start;
+		if (split < end)
 		{
-			int32_t digit = line[j] - '0';
-			if (digit > digits[dig_idx])
-			{
-				digits[dig_idx] = digit;
-				last_idx = j;
-			}
+			split = memchr(split, '\n', end - split);
+			split = split == NULL ? end : split + 1;
 		}
+		chunks[n_chunks] = (struct chunk){.start = start, .end = split, .n_digits = n_digits};
+		if (pthread_create(&chunks[n_chunks].thread, NULL, chunk_routine, &chunks[n_chunks]) != 0)
+		{
+			status = (printf("Failed to create thread\n"), 1);
+			break ;
+		}
+		n_chunks++;
+		start = split;
 	}
 
-	uint64_t	joltage = 0;
-
-	for (int32_t i = 0; i < n_digits; i++)
+	for (int64_t i = 0; i < n_chunks; i++)
 	{
-		joltage += digits[i] * pow_int(10, n_digits - i - 1);
+		pthread_join(chunks[i].thread, NULL);
+		bignum_add(total, &chunks[i].total);
 	}
 
-	printf("joltage: %12ld %s\n", joltage, line);
-	return  (joltage);
+	free(chunks);
+	munmap((void *)data, st.st_size);
+	return (status);
 }
 
 int	main(int argc, char **argv)
 {
-	if (argc != 2)
+	if (argc < 2)
 		return (printf("No file provided\n"), 1);
 
+	int32_t	n_digits = 12;
+	if (argc > 2)
+	{
+		char *endptr;
+		errno = 0;
+		n_digits = strtol(argv[2], &endptr, 10);
+		if (*endptr != '\0' || errno != 0 || n_digits <= 0 || n_digits > JOLT_MAX_DIGITS)
+			return (printf("Error parsing digit count (1-%d)\n", JOLT_MAX_DIGITS), 1);
+	}
+
+	struct bignum	total = {};
+	if (argc > 3)
+	{
+		char *endptr;
+		errno = 0;
+		int64_t n_threads = strtol(argv[3], &endptr, 10);
+		if (*endptr != '\0' || errno != 0 || n_threads < 0)
+			return (printf("Error parsing thread count\n"), 1);
+		if (n_threads == 0)
+			n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+		if (solve_parallel(argv[1], n_digits, n_threads, &total) != 0)
+			return (1);
+		printf("Total: ");
+		bignum_print(&total);
+		printf("\n");
+		return (0);
+	}
+
 	FILE *fp = fopen(argv[1], "r");
 	if (fp == NULL)
 		return (printf("Failed to open file\n"), 1);
 
-	char		*line;
-	uint64_t	size;
-	uint64_t		total = 0;
+	char			*line = NULL;
+	uint64_t		size = 0;
 
 	while (getline(&line, &size, fp) != -1)
 	{
-		total += get_joltage(line, 12);
+		get_joltage(line, n_digits, &total);
 	}
 
-	printf("\nTotal: %lu\n", total);
+	printf("\nTotal: ");
+	bignum_print(&total);
+	printf("\n");
 	free(line);
 	fclose(fp);
 }
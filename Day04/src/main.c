@@ -7,6 +7,9 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <immintrin.h>
 
 void	trim_nl(char *line)
 {
@@ -16,74 +19,530 @@ void	trim_nl(char *line)
 		line[len- 1 ] = '\0';
 }
 
-void	remove_accessible(char **lines, uint64_t len, uint64_t n_lines)
+// Number of rolls removed in each wave and, if wave_map is set, the wave in
+// which each cell was removed (1-based, 0 = never removed, saturating).
+struct wave_stats
 {
+	uint64_t	*removed;
+	uint64_t	n_waves;
+	uint64_t	size;
+	uint16_t	*wave_map;
+	uint64_t	width;
+	uint64_t	height;
+};
+
+void	wave_stats_push(struct wave_stats *stats, uint64_t removed)
+{
+	if (stats->n_waves == stats->size)
+	{
+		stats->size = stats->size == 0 ? 256 : stats->size * 2;
+		stats->removed = realloc(stats->removed, stats->size * sizeof(uint64_t));
+	}
+	stats->removed[stats->n_waves++] = removed;
+}
+
+uint16_t	wave_label(uint64_t wave)
+{
+	return (wave < UINT16_MAX ? wave + 1 : UINT16_MAX);
+}
+
+// Rolls are stored one byte per cell with a one cell border of empty floor
+// on every side, so neighbour lookups never need bounds checks.
+struct grid
+{
+	uint8_t		*rolls;
+	uint8_t		*counts;
+	uint64_t	width;
+	uint64_t	height;
+	int64_t		offsets[8];
+};
+
+struct grid	build_grid(char **lines, uint64_t n_lines)
+{
+	struct grid	grid = {};
+	uint64_t	len = n_lines > 0 ? strlen(lines[0]) : 0;
+
+	grid.width = len + 2;
+	grid.height = n_lines + 2;
+	grid.rolls = calloc(grid.width * grid.height, sizeof(uint8_t));
+	grid.counts = calloc(grid.width * grid.height, sizeof(uint8_t));
+
+	int64_t	w = grid.width;
+	int64_t	offsets[8] = {-w - 1, -w, -w + 1, -1, 1, w - 1, w, w + 1};
+	memcpy(grid.offsets, offsets, sizeof(offsets));
+
 	for (uint64_t i = 0; i < n_lines; i++)
 	{
-		for (uint64_t j = 0; j < len; j++)
+		for (uint64_t j = 0; j < len && lines[i][j] != '\0'; j++)
+			grid.rolls[(i + 1) * grid.width + j + 1] = lines[i][j] == '@';
+	}
+
+	for (uint64_t idx = grid.width; idx < (grid.height - 1) * grid.width; idx++)
+	{
+		if (!grid.rolls[idx])
+			continue ;
+		for (int32_t k = 0; k < 8; k++)
+			grid.counts[idx] += grid.rolls[idx + grid.offsets[k]];
+	}
+	return (grid);
+}
+
+void	free_grid(struct grid *grid)
+{
+	free(grid->rolls);
+	free(grid->counts);
+}
+
+// Removes accessible rolls wave by wave. Every roll is queued at most once:
+// the initial wave is every roll with fewer than 4 neighbours, and removing a
+// roll only queues the neighbours whose count drops from 4 to 3, so the
+// total work is O(cells + removals).
+uint64_t	remove_all_accessible(struct grid *grid, struct wave_stats *stats)
+{
+	uint64_t	*queue = malloc(grid->width * grid->height * sizeof(uint64_t));
+	uint64_t	head = 0;
+	uint64_t	tail = 0;
+
+	for (uint64_t idx = grid->width; idx < (grid->height - 1) * grid->width; idx++)
+	{
+		if (grid->rolls[idx] && grid->counts[idx] < 4)
+			queue[tail++] = idx;
+	}
+
+	while (head < tail)
+	{
+		uint64_t	wave_end = tail;
+		uint16_t	label = wave_label(stats->n_waves);
+
+		wave_stats_push(stats, wave_end - head);
+		for (; head < wave_end; head++)
 		{
-			if (lines[i][j] == 'x')
-				lines[i][j] = '.';
+			uint64_t	idx = queue[head];
+
+			grid->rolls[idx] = 0;
+			if (stats->wave_map != NULL)
+				stats->wave_map[(idx / grid->width - 1) * stats->width + idx % grid->width - 1] = label;
+			for (int32_t k = 0; k < 8; k++)
+			{
+				uint64_t	nb = idx + grid->offsets[k];
+				if (grid->rolls[nb] && grid->counts[nb]-- == 4)
+					queue[tail++] = nb;
+			}
 		}
 	}
+
+	free(queue);
+	return (tail);
 }
 
-uint64_t	count_accessible(char **lines, uint64_t n_lines)
+// One bit per cell, 64 cells per word. Each row is padded with a zero word on
+// either side and the board with a zero row above and below, so shifted
+// neighbour words can always be loaded. Rows are rounded up to a multiple of
+// 4 words for the AVX2 kernel.
+struct bitboard
 {
-	uint64_t	len = strlen(lines[0]);
-	uint64_t	accessible = 0;
-	int32_t		neighbours;
-	uint64_t	max_y = n_lines - 1;
-	uint64_t	max_x = len - 1;
+	uint64_t	*cur;
+	uint64_t	*next;
+	uint64_t	n_words;
+	uint64_t	stride;
+	uint64_t	n_rows;
+	uint16_t	*wave_map;
+	uint64_t	map_width;
+	uint16_t	label;
+};
 
-	for (uint64_t i = 0; i < n_lines; i++)
+// Builds the board for rows [first, last) of the input. The padding rows
+// above and below are filled from the neighbouring input rows, if any, so a
+// band of a larger floor starts with its halos in place.
+struct bitboard	build_bitboard(char **lines, uint64_t len, uint64_t first, uint64_t last, uint64_t n_lines)
+{
+	struct bitboard	board = {};
+	uint64_t		n_rows = last - first;
+
+	board.n_words = ((len + 255) / 256) * 4;
+	board.stride = board.n_words + 2;
+	board.n_rows = n_rows;
+	board.cur = calloc(board.stride * (n_rows + 2), sizeof(uint64_t));
+	board.next = calloc(board.stride * (n_rows + 2), sizeof(uint64_t));
+
+	for (uint64_t i = first > 0 ? first - 1 : 0; i <= last && i < n_lines; i++)
 	{
-		// printf("<%s>\n", lines[i]);
-		for (uint64_t j = 0; j < len; j++)
+		uint64_t	*row = board.cur + (i + 1 - first) * board.stride + 1;
+		for (uint64_t j = 0; j < len && lines[i][j] != '\0'; j++)
 		{
-			if (lines[i][j] != '@')
-				continue ;
-			neighbours = 0;
-			if (j > 0 && (lines[i][j - 1] == '@' || lines[i][j - 1] == 'x'))
-				neighbours++;
-			if (i > 0 && (lines[i - 1][j] == '@' || lines[i - 1][j] == 'x'))
-				neighbours++;
-			if (j > 0 && i < max_y && (lines[i + 1][j - 1] == '@' || lines[i + 1][j - 1] == 'x'))
-				neighbours++;
-			if (i > 0 && j < max_x && (lines[i - 1][j + 1] == '@' || lines[i - 1][j + 1] == 'x'))
-				neighbours++;
-			if (i < max_y && j < max_x && (lines[i + 1][j + 1] == '@' || lines[i + 1][j + 1] == 'x'))
-				neighbours++;
-			if (j < max_x && (lines[i][j + 1] == '@' || lines[i][j + 1] == 'x'))
-				neighbours++;
-			if (i < max_y && (lines[i + 1][j] == '@' || lines[i + 1][j] == 'x'))
-				neighbours++;
-			if (i > 0 && j > 0 && (lines[i - 1][j - 1] == '@' || lines[i - 1][j - 1] == 'x'))
-				neighbours++;
-			if (neighbours < 4)
+			if (lines[i][j] == '@')
+				row[j / 64] |= 1UL << (j % 64);
+		}
+	}
+	return (board);
+}
+
+void	free_bitboard(struct bitboard *board)
+{
+	free(board->cur);
+	free(board->next);
+}
+
+// Bit-sliced sum of the 8 neighbour bitboards, returning the cells with at
+// least 4 neighbours. The weight-1 bits are reduced with full adders, then
+// the weight-2 carries, leaving two weight-4 carries whose union is
+// "count >= 4".
+uint64_t	ge4_u64(uint64_t n0, uint64_t n1, uint64_t n2, uint64_t n3,
+				uint64_t n4, uint64_t n5, uint64_t n6, uint64_t n7)
+{
+	uint64_t	x0 = n0 ^ n1;
+	uint64_t	s0 = x0 ^ n2;
+	uint64_t	c0 = (n0 & n1) | (x0 & n2);
+	uint64_t	x1 = n3 ^ n4;
+	uint64_t	s1 = x1 ^ n5;
+	uint64_t	c1 = (n3 & n4) | (x1 & n5);
+	uint64_t	s2 = n6 ^ n7;
+	uint64_t	c2 = n6 & n7;
+	uint64_t	x2 = s0 ^ s1;
+	uint64_t	c3 = (s0 & s1) | (x2 & s2);
+	uint64_t	x3 = c0 ^ c1;
+	uint64_t	t = x3 ^ c2;
+	uint64_t	c4 = (c0 & c1) | (x3 & c2);
+
+	return (c4 | (t & c3));
+}
+
+#ifdef __AVX2__
+__m256i	ge4_avx2(__m256i n0, __m256i n1, __m256i n2, __m256i n3,
+			__m256i n4, __m256i n5, __m256i n6, __m256i n7)
+{
+	__m256i	x0 = _mm256_xor_si256(n0, n1);
+	__m256i	s0 = _mm256_xor_si256(x0, n2);
+	__m256i	c0 = _mm256_or_si256(_mm256_and_si256(n0, n1), _mm256_and_si256(x0, n2));
+	__m256i	x1 = _mm256_xor_si256(n3, n4);
+	__m256i	s1 = _mm256_xor_si256(x1, n5);
+	__m256i	c1 = _mm256_or_si256(_mm256_and_si256(n3, n4), _mm256_and_si256(x1, n5));
+	__m256i	s2 = _mm256_xor_si256(n6, n7);
+	__m256i	c2 = _mm256_and_si256(n6, n7);
+	__m256i	x2 = _mm256_xor_si256(s0, s1);
+	__m256i	c3 = _mm256_or_si256(_mm256_and_si256(s0, s1), _mm256_and_si256(x2, s2));
+	__m256i	x3 = _mm256_xor_si256(c0, c1);
+	__m256i	t = _mm256_xor_si256(x3, c2);
+	__m256i	c4 = _mm256_or_si256(_mm256_and_si256(c0, c1), _mm256_and_si256(x3, c2));
+
+	return (_mm256_or_si256(c4, _mm256_and_si256(t, c3)));
+}
+#endif
+
+void	mark_removed(struct bitboard *board, uint64_t row, uint64_t word, uint64_t gone)
+{
+	uint16_t	*map_row = board->wave_map + row * board->map_width;
+
+	while (gone != 0)
+	{
+		map_row[word * 64 + __builtin_ctzll(gone)] = board->label;
+		gone &= gone - 1;
+	}
+}
+
+// Computes one removal wave into board->next and returns the number of rolls
+// removed. Every roll with fewer than 4 neighbours is removed at once.
+uint64_t	bitboard_wave_rows(struct bitboard *board, uint64_t first, uint64_t last)
+{
+	uint64_t	removed = 0;
+
+	for (uint64_t i = first; i < last; i++)
+	{
+		const uint64_t	*a = board->cur + i * board->stride + 1;
+		const uint64_t	*r = a + board->stride;
+		const uint64_t	*b = r + board->stride;
+		uint64_t		*out = board->next + (i + 1) * board->stride + 1;
+		uint64_t		w = 0;
+
+#ifdef __AVX2__
+		for (; w + 4 <= board->n_words; w += 4)
+		{
+#define LOAD(p) _mm256_loadu_si256((const __m256i *)(p))
+#define WEST(p) _mm256_or_si256(_mm256_slli_epi64(LOAD(p + w), 1), _mm256_srli_epi64(LOAD(p + w - 1), 63))
+#define EAST(p) _mm256_or_si256(_mm256_srli_epi64(LOAD(p + w), 1), _mm256_slli_epi64(LOAD(p + w + 1), 63))
+			__m256i	row = LOAD(r + w);
+			__m256i	ge4 = ge4_avx2(WEST(a), LOAD(a + w), EAST(a), WEST(r),
+								EAST(r), WEST(b), LOAD(b + w), EAST(b));
+			__m256i	keep = _mm256_and_si256(row, ge4);
+			__m256i	gone = _mm256_andnot_si256(ge4, row);
+#undef LOAD
+#undef WEST
+#undef EAST
+			_mm256_storeu_si256((__m256i *)(out + w), keep);
+			removed += __builtin_popcountll(_mm256_extract_epi64(gone, 0))
+				+ __builtin_popcountll(_mm256_extract_epi64(gone, 1))
+				+ __builtin_popcountll(_mm256_extract_epi64(gone, 2))
+				+ __builtin_popcountll(_mm256_extract_epi64(gone, 3));
+			if (board->wave_map != NULL && !_mm256_testz_si256(gone, gone))
 			{
-				printf("%s  x: %lu y: %lu\n", lines[i], j, i);
-				accessible++;
-				lines[i][j] = 'x';
+				for (int32_t k = 0; k < 4; k++)
+					mark_removed(board, i, w + k, ((uint64_t *)&gone)[k]);
 			}
 		}
+#endif
+		for (; w < board->n_words; w++)
+		{
+#define WEST(p) ((p[w] << 1) | (p[w - 1] >> 63))
+#define EAST(p) ((p[w] >> 1) | (p[w + 1] << 63))
+			uint64_t	ge4 = ge4_u64(WEST(a), a[w], EAST(a), WEST(r),
+								EAST(r), WEST(b), b[w], EAST(b));
+#undef WEST
+#undef EAST
+			out[w] = r[w] & ge4;
+			removed += __builtin_popcountll(r[w] & ~ge4);
+			if (board->wave_map != NULL)
+				mark_removed(board, i, w, r[w] & ~ge4);
+		}
+	}
+	return (removed);
+}
+
+uint64_t	bitboard_remove_all(struct bitboard *board, struct wave_stats *stats)
+{
+	uint64_t	total = 0;
+	uint64_t	removed;
+
+	board->wave_map = stats->wave_map;
+	board->map_width = stats->width;
+	board->label = wave_label(stats->n_waves);
+	while ((removed = bitboard_wave_rows(board, 0, board->n_rows)) > 0)
+	{
+		uint64_t	*tmp = board->cur;
+		board->cur = board->next;
+		board->next = tmp;
+		total += removed;
+		wave_stats_push(stats, removed);
+		board->label = wave_label(stats->n_waves);
+	}
+	return (total);
+}
+
+// Row band of the floor owned by one worker. Each band keeps its own
+// bitboard whose padding rows are one-row halos mirroring the neighbouring
+// bands' edge rows; they are refreshed between waves.
+// Upper bound on band threads per online core for an explicit -t
+#define MAX_THREADS_PER_CORE 4
+
+struct band
+{
+	pthread_t			thread;
+	uint64_t			id;
+	struct bitboard		board;
+	struct band			*bands;
+	uint64_t			n_bands;
+	char				**lines;
+	uint64_t			len;
+	uint64_t			first;
+	uint64_t			last;
+	uint64_t			n_lines;
+	pthread_barrier_t	*barrier;
+	pthread_mutex_t		*start;
+	bool				*aborted;
+	uint64_t			(*removed)[2];
+	uint64_t			total;
+	struct wave_stats	*stats;
+};
+
+void	exchange_halos(struct band *band)
+{
+	struct bitboard	*board = &band->board;
+	uint64_t		row_size = board->stride * sizeof(uint64_t);
+
+	if (band->id > 0)
+	{
+		struct bitboard	*above = &band->bands[band->id - 1].board;
+		memcpy(above->cur + (above->n_rows + 1) * above->stride, board->cur + board->stride, row_size);
+	}
+	if (band->id + 1 < band->n_bands)
+	{
+		struct bitboard	*below = &band->bands[band->id + 1].board;
+		memcpy(below->cur, board->cur + board->n_rows * board->stride, row_size);
 	}
-	remove_accessible(lines, len, n_lines);
-	return accessible;
+}
+
+// Each wave: compute the band's removals from the current state, swap
+// buffers, then after a barrier push the new edge rows into the neighbours'
+// halos. A second barrier makes the halos and per-band counts visible before
+// anyone starts the next wave, so waves match the sequential engine exactly.
+// Bands hold at the start lock until every thread is up, and leave without
+// touching the barrier if one of them failed to start.
+void	*band_routine(void *arg)
+{
+	struct band		*band = arg;
+	struct bitboard	*board = &band->board;
+	uint64_t		parity = 0;
+	uint64_t		wave = 0;
+
+	pthread_mutex_lock(band->start);
+	bool	aborted = *band->aborted;
+	pthread_mutex_unlock(band->start);
+	if (aborted)
+		return (NULL);
+	*board = build_bitboard(band->lines, band->len, band->first, band->last, band->n_lines);
+	if (band->stats->wave_map != NULL)
+		board->wave_map = band->stats->wave_map + band->first * band->stats->width;
+	board->map_width = band->stats->width;
+	pthread_barrier_wait(band->barrier);
+	while (true)
+	{
+		board->label = wave_label(wave);
+		band->removed[band->id][parity] = bitboard_wave_rows(board, 0, board->n_rows);
+		uint64_t	*tmp = board->cur;
+		board->cur = board->next;
+		board->next = tmp;
+		pthread_barrier_wait(band->barrier);
+
+		exchange_halos(band);
+		pthread_barrier_wait(band->barrier);
+
+		uint64_t	removed = 0;
+		for (uint64_t i = 0; i < band->n_bands; i++)
+			removed += band->removed[i][parity];
+		if (removed == 0)
+			break ;
+		band->total += removed;
+		if (band->id == 0)
+			wave_stats_push(band->stats, removed);
+		wave++;
+		parity ^= 1;
+	}
+	return (NULL);
+}
+
+int	bands_remove_all(char **lines, uint64_t n_lines, uint64_t n_threads, struct wave_stats *stats,
+		uint64_t *total)
+{
+	uint64_t			len = n_lines > 0 ? strlen(lines[0]) : 0;
+	uint64_t			n_bands = n_threads < n_lines ? n_threads : n_lines;
+	struct band			*bands = calloc(n_bands, sizeof(struct band));
+	uint64_t			(*removed)[2] = calloc(n_bands, sizeof(*removed));
+	pthread_barrier_t	barrier;
+	pthread_mutex_t		start = PTHREAD_MUTEX_INITIALIZER;
+	bool				aborted = false;
+	uint64_t			n_started = 0;
+
+	*total = 0;
+	if (n_bands == 0)
+		return (free(bands), free(removed), 0);
+
+	pthread_barrier_init(&barrier, NULL, n_bands);
+	pthread_mutex_lock(&start);
+	for (uint64_t i = 0; i < n_bands; i++)
+	{
+		bands[i] = (struct band){
+			.id = i,
+			.bands = bands,
+			.n_bands = n_bands,
+			.lines = lines,
+			.len = len,
+			.first = n_lines * i / n_bands,
+			.last = n_lines * (i + 1) / n_bands,
+			.n_lines = n_lines,
+			.barrier = &barrier,
+			.start = &start,
+			.aborted = &aborted,
+			.removed = removed,
+			.stats = stats,
+		};
+		if (pthread_create(&bands[i].thread, NULL, band_routine, &bands[i]) != 0)
+		{
+			aborted = true;
+			break ;
+		}
+		n_started++;
+	}
+	pthread_mutex_unlock(&start);
+	for (uint64_t i = 0; i < n_started; i++)
+	{
+		pthread_join(bands[i].thread, NULL);
+		free_bitboard(&bands[i].board);
+	}
+
+	if (!aborted)
+		*total = bands[0].total;
+	pthread_barrier_destroy(&barrier);
+	free(removed);
+	free(bands);
+	if (aborted)
+		return (printf("Failed to create thread\n"), 1);
+	return (0);
+}
+
+// Writes the wave data as a PGM image if the path ends in ".pgm", otherwise
+// as raw little-endian binary: width, height and wave count as uint64, the
+// per-wave removal counts as uint64, then the uint16 wave map row by row.
+int	export_waves(const char *path, struct wave_stats *stats)
+{
+	FILE		*fp = fopen(path, "wb");
+	uint64_t	n_cells = stats->width * stats->height;
+	uint64_t	len = strlen(path);
+
+	if (fp == NULL)
+		return (1);
+
+	if (len >= 4 && strcmp(path + len - 4, ".pgm") == 0)
+	{
+		uint64_t	max = stats->n_waves < UINT16_MAX ? stats->n_waves : UINT16_MAX;
+		if (max == 0)
+			max = 1;
+		fprintf(fp, "P5\n%lu %lu\n%lu\n", stats->width, stats->height, max);
+		for (uint64_t i = 0; i < n_cells; i++)
+		{
+			if (max > 255)
+				fputc(stats->wave_map[i] >> 8, fp);
+			fputc(stats->wave_map[i] & 0xff, fp);
+		}
+	}
+	else
+	{
+		fwrite(&stats->width, sizeof(uint64_t), 1, fp);
+		fwrite(&stats->height, sizeof(uint64_t), 1, fp);
+		fwrite(&stats->n_waves, sizeof(uint64_t), 1, fp);
+		fwrite(stats->removed, sizeof(uint64_t), stats->n_waves, fp);
+		fwrite(stats->wave_map, sizeof(uint16_t), n_cells, fp);
+	}
+	return (fclose(fp) != 0);
 }
 
 int	main(int argc, char **argv)
 {
-	if (argc != 2)
+	bool		use_bitboard = false;
+	bool		print_waves = false;
+	char		*export_path = NULL;
+	uint64_t	n_threads = 0;
+	int			opt;
+	char		*endptr;
+
+	while ((opt = getopt(argc, argv, "bt:wo:")) != -1)
+	{
+		if (opt == 'b')
+			use_bitboard = true;
+		else if (opt == 't')
+		{
+			errno = 0;
+			n_threads = strtoul(optarg, &endptr, 10);
+			if (*endptr != '\0' || errno != 0 || n_threads == 0 || optarg[0] == '-')
+				return (printf("Error parsing thread count\n"), 1);
+			if (n_threads > (uint64_t)sysconf(_SC_NPROCESSORS_ONLN) * MAX_THREADS_PER_CORE)
+				n_threads = sysconf(_SC_NPROCESSORS_ONLN) * MAX_THREADS_PER_CORE;
+		}
+		else if (opt == 'w')
+			print_waves = true;
+		else if (opt == 'o')
+			export_path = optarg;
+		else
+			return (printf("Usage: %s [-b] [-t threads] [-w] [-o export] <file>\n", argv[0]), 1);
+	}
+	if (optind != argc - 1)
 		return (printf("No file provided\n"), 1);
 
-	FILE *fp = fopen(argv[1], "r");
+	FILE *fp = fopen(argv[optind], "r");
 	if (fp == NULL)
 		return (printf("Failed to open file\n"), 1);
 
 	uint64_t	lines_size = 256;
 	char		**lines = calloc(lines_size, sizeof(char *));
-	uint64_t	size;
+	uint64_t	size = 0;
 	uint64_t	n_lines = 0;
 
 	while (getline(&lines[n_lines], &size, fp) != -1)
@@ -92,6 +551,7 @@ int	main(int argc, char **argv)
 		{
 			lines_size *= 2;
 			lines = realloc(lines, lines_size * sizeof(char *));
+			memset(&lines[n_lines + 1], 0, (lines_size - n_lines - 1) * sizeof(char *));
 		}
 		trim_nl(lines[n_lines]);
 		n_lines++;
@@ -101,18 +561,48 @@ int	main(int argc, char **argv)
 	// for (uint64_t i = 0; i < n_lines; i++)
 	// 	printf("%s\n", lines[i]);
 
-	uint64_t	total = 0;
-	uint64_t	accessible = count_accessible(lines, n_lines);
-	while (accessible > 0)
+	uint64_t			len = n_lines > 0 ? strlen(lines[0]) : 0;
+	uint64_t			total = 0;
+	int					status = 0;
+	struct wave_stats	stats = {.width = len, .height = n_lines};
+
+	if (export_path != NULL)
+		stats.wave_map = calloc(len * n_lines, sizeof(uint16_t));
+
+	if (n_threads > 0)
+		status = bands_remove_all(lines, n_lines, n_threads, &stats, &total);
+	else if (use_bitboard)
+	{
+		struct bitboard	board = build_bitboard(lines, len, 0, n_lines, n_lines);
+		total = bitboard_remove_all(&board, &stats);
+		free_bitboard(&board);
+	}
+	else
+	{
+		struct grid	grid = build_grid(lines, n_lines);
+		total = remove_all_accessible(&grid, &stats);
+		free_grid(&grid);
+	}
+
+	if (status == 0 && print_waves)
 	{
-		total += accessible;
-		accessible = count_accessible(lines, n_lines);
+		for (uint64_t i = 0; i < stats.n_waves; i++)
+			printf("wave %lu: %lu\n", i + 1, stats.removed[i]);
 	}
+	if (status == 0 && export_path != NULL && export_waves(export_path, &stats) != 0)
+		printf("Failed to export waves to %s\n", export_path);
 
-	printf("total: %lu\n", total);
+	if (status == 0)
+	{
+		printf("waves: %lu\n", stats.n_waves);
+		printf("total: %lu\n", total);
+	}
 
 	for (uint64_t i = 0; i <= n_lines; i++)
 		free(lines[i]);
 	free(lines);
+	free(stats.removed);
+	free(stats.wave_map);
 	fclose(fp);
+	return (status);
 }
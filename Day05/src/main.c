@@ -7,6 +7,8 @@
 #include <fcntl.h>
 #include <stdbool.h>
 #include <sys/types.h>
+#include <pthread.h>
+#include <unistd.h>
 
 enum {
 	MODE_GET_RANGES = 0,
@@ -85,92 +87,656 @@ struct range	parse_range(char *line)
 	return (range);
 }
 
-uint8_t	check_fresh(char *line, struct range *ranges, uint64_t n_ranges)
+uint64_t	parse_id(char *line)
 {
 	uint64_t	id;
 	char		*endptr;
 
 	errno = 0;
-	id = strtol(line, &endptr, 10);
+	id = strtoul(line, &endptr, 10);
 	if (*endptr != '\0' || errno != 0)
 		return (errno = 1, 0);
+	return (id);
+}
+
+// LSD radix sort on low, one byte per pass. All eight histograms are built
+// in a single read, and passes where every key has the same byte are skipped.
+void	radix_sort_ranges(struct range *ranges, uint64_t n_ranges)
+{
+	uint64_t		counts[8][256] = {};
+	struct range	*tmp = malloc(n_ranges * sizeof(struct range));
+	struct range	*src = ranges;
+	struct range	*dst = tmp;
 
 	for (uint64_t i = 0; i < n_ranges; i++)
 	{
-		if (id >= ranges[i].low && id <= ranges[i].high)
-			return (1);
+		for (int32_t pass = 0; pass < 8; pass++)
+			counts[pass][(ranges[i].low >> (pass * 8)) & 0xff]++;
 	}
-	return (0);
-}
 
-void	swap_ranges(struct range *ranges, uint64_t i, uint64_t j)
-{
-	struct range	tmp;
+	for (int32_t pass = 0; pass < 8; pass++)
+	{
+		uint64_t	offset = 0;
+		int32_t		shift = pass * 8;
 
-	tmp = ranges[i];
-	ranges[i] = ranges[j];
-	ranges[j] = tmp;
+		if (counts[pass][(ranges[0].low >> shift) & 0xff] == n_ranges)
+			continue ;
+		for (int32_t i = 0; i < 256; i++)
+		{
+			uint64_t	count = counts[pass][i];
+			counts[pass][i] = offset;
+			offset += count;
+		}
+		for (uint64_t i = 0; i < n_ranges; i++)
+			dst[counts[pass][(src[i].low >> shift) & 0xff]++] = src[i];
+
+		struct range	*swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	if (src != ranges)
+		memcpy(ranges, src, n_ranges * sizeof(struct range));
+	free(tmp);
 }
 
-void	quicksort_ranges_low(struct range *ranges, int64_t left, int64_t right)
+// Sorts the ranges and merges overlapping ones in place in a single pass,
+// returning the number of disjoint ranges left.
+uint64_t	normalise_ranges(struct range *ranges, uint64_t n_ranges)
 {
-	int64_t	i;
-	int64_t	pivot = (left + right) / 2;
-	int64_t	last;
+	uint64_t	last = 0;
 
-	if (left >= right)
-		return ;
+	if (n_ranges == 0)
+		return (0);
 
-	swap_ranges(ranges, left, pivot);
-	last = left;
-	i = left + 1;
-	while (i <= right)
+	radix_sort_ranges(ranges, n_ranges);
+	for (uint64_t i = 1; i < n_ranges; i++)
 	{
-		if (ranges[left].low > ranges[i].low)
-			swap_ranges(ranges, ++last, i);
-		i++;
+		if (ranges[i].low <= ranges[last].high)
+		{
+			if (ranges[last].high < ranges[i].high)
+				ranges[last].high = ranges[i].high;
+		}
+		else
+			ranges[++last] = ranges[i];
 	}
-	swap_ranges(ranges, left, last);
-	quicksort_ranges_low(ranges, left, last - 1);
-	quicksort_ranges_low(ranges, last + 1, right);
+	return (last + 1);
 }
 
+// Expects normalised ranges
 uint64_t	calculate_total_fresh(struct range *ranges, uint64_t n_ranges)
 {
 	uint64_t	total = 0;
-	uint64_t	i = 0;
 
-	quicksort_ranges_low(ranges, 0, n_ranges - 1);
-	while (i < n_ranges - 1)
+	for (uint64_t i = 0; i < n_ranges; i++)
 	{
 		// printf("%lu : %lu\n", ranges[i].low, ranges[i].high);
+		total += ranges[i].high - ranges[i].low + 1;
+	}
+
+	return (total);
+}
+
+#define INDEX_LANES 8
+
+// Normalised ranges in Eytzinger (BFS) order, keyed on high: since the ranges
+// are disjoint and sorted, highs are sorted too, and the first range whose
+// high is >= id is the only one that can contain id. Node 0 is an empty
+// sentinel range, which is where a search past the last range lands.
+struct range_index
+{
+	uint64_t	*highs;
+	uint64_t	*lows;
+	uint64_t	n_nodes;
+	int32_t		depth;
+};
+
+uint64_t	eytzinger_fill(struct range_index *index, struct range *ranges, uint64_t i, uint64_t k)
+{
+	if (k <= index->n_nodes)
+	{
+		i = eytzinger_fill(index, ranges, i, 2 * k);
+		index->highs[k] = ranges[i].high;
+		index->lows[k] = ranges[i].low;
+		i = eytzinger_fill(index, ranges, i + 1, 2 * k + 1);
+	}
+	return (i);
+}
+
+// Expects normalised ranges
+struct range_index	build_range_index(struct range *ranges, uint64_t n_ranges)
+{
+	struct range_index	index = {.n_nodes = n_ranges};
+	uint64_t			size = ((n_ranges + 1) * sizeof(uint64_t) + 63) & ~63UL;
+
+	index.highs = aligned_alloc(64, size);
+	index.lows = aligned_alloc(64, size);
+	index.highs[0] = 0;
+	index.lows[0] = 1;
+	eytzinger_fill(&index, ranges, 0, 1);
+	while ((1UL << index.depth) <= n_ranges)
+		index.depth++;
+	return (index);
+}
+
+void	free_range_index(struct range_index *index)
+{
+	free(index->highs);
+	free(index->lows);
+}
+
+// Descends comparing against highs and prefetching the node 3 levels down,
+// then strips the trailing right turns to recover the lower bound node.
+bool	index_check_fresh(const struct range_index *index, uint64_t id)
+{
+	uint64_t	k = 1;
 
-		if (ranges[i].high >= ranges[i + 1].low)
+	while (k <= index->n_nodes)
+	{
+		__builtin_prefetch(index->highs + k * 8);
+		k = 2 * k + (index->highs[k] < id);
+	}
+	k >>= __builtin_ffsll(~k);
+	return ((id >= index->lows[k]) & (id <= index->highs[k]));
+}
+
+// Checks a column of ids, writing one flag per id to fresh if it is not NULL,
+// and returns how many are fresh. INDEX_LANES searches run in lockstep so
+// their cache misses overlap.
+uint64_t	index_check_batch(const struct range_index *index, const uint64_t *ids, uint64_t n_ids, uint8_t *fresh)
+{
+	uint64_t	n_fresh = 0;
+	uint64_t	i = 0;
+
+	for (; i + INDEX_LANES <= n_ids; i += INDEX_LANES)
+	{
+		uint64_t	k[INDEX_LANES];
+
+		for (int32_t lane = 0; lane < INDEX_LANES; lane++)
+			k[lane] = 1;
+		for (int32_t level = 0; level < index->depth; level++)
 		{
-			if (ranges[i].high < ranges[i + 1].high)
-				ranges[i].high = ranges[i + 1].high;
-			memmove(&ranges[i + 1], &ranges[i + 2], (n_ranges - i - 2) * sizeof(struct range));
-			n_ranges--;
+			for (int32_t lane = 0; lane < INDEX_LANES; lane++)
+			{
+				uint64_t	node = k[lane] <= index->n_nodes ? k[lane] : 0;
+				uint64_t	child = 2 * k[lane] + (index->highs[node] < ids[i + lane]);
+				__builtin_prefetch(index->highs + k[lane] * 8);
+				k[lane] = node != 0 ? child : k[lane];
+			}
+		}
+		for (int32_t lane = 0; lane < INDEX_LANES; lane++)
+		{
+			uint64_t	node = k[lane] >> __builtin_ffsll(~k[lane]);
+			uint8_t		is_fresh = (ids[i + lane] >= index->lows[node]) & (ids[i + lane] <= index->highs[node]);
+			if (fresh != NULL)
+				fresh[i + lane] = is_fresh;
+			n_fresh += is_fresh;
 		}
-		else
-			i++;
 	}
+	for (; i < n_ids; i++)
+	{
+		uint8_t	is_fresh = index_check_fresh(index, ids[i]);
+		if (fresh != NULL)
+			fresh[i] = is_fresh;
+		n_fresh += is_fresh;
+	}
+	return (n_fresh);
+}
 
-	for (uint64_t i = 0; i < n_ranges; i++)
+#define PARALLEL_MIN_IDS (1UL << 22)
+// Upper bound on worker threads per online core for an explicit -t
+#define MAX_THREADS_PER_CORE 4
+
+void	radix_sort_ids(uint64_t *ids, uint64_t n_ids)
+{
+	uint64_t	counts[8][256] = {};
+	uint64_t	*tmp = malloc(n_ids * sizeof(uint64_t));
+	uint64_t	*src = ids;
+	uint64_t	*dst = tmp;
+
+	for (uint64_t i = 0; i < n_ids; i++)
 	{
-		printf("%lu : %lu\n", ranges[i].low, ranges[i].high);
-		total += ranges[i].high - ranges[i].low + 1;
+		for (int32_t pass = 0; pass < 8; pass++)
+			counts[pass][(ids[i] >> (pass * 8)) & 0xff]++;
 	}
 
-	return (total);
+	for (int32_t pass = 0; pass < 8 && n_ids > 0; pass++)
+	{
+		uint64_t	offset = 0;
+		int32_t		shift = pass * 8;
+
+		if (counts[pass][(ids[0] >> shift) & 0xff] == n_ids)
+			continue ;
+		for (int32_t i = 0; i < 256; i++)
+		{
+			uint64_t	count = counts[pass][i];
+			counts[pass][i] = offset;
+			offset += count;
+		}
+		for (uint64_t i = 0; i < n_ids; i++)
+			dst[counts[pass][(src[i] >> shift) & 0xff]++] = src[i];
+
+		uint64_t	*swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	if (src != ids)
+		memcpy(ids, src, n_ids * sizeof(uint64_t));
+	free(tmp);
+}
+
+// Walks sorted ids and normalised ranges together, writing the fresh ids to
+// fresh if it is not NULL, and returns how many are fresh.
+uint64_t	merge_join_fresh(const uint64_t *ids, uint64_t n_ids, const struct range *ranges, uint64_t n_ranges, uint64_t *fresh)
+{
+	uint64_t	n_fresh = 0;
+	uint64_t	j = 0;
+
+	for (uint64_t i = 0; i < n_ids; i++)
+	{
+		while (j < n_ranges && ranges[j].high < ids[i])
+			j++;
+		if (j == n_ranges)
+			break ;
+		if (ids[i] >= ranges[j].low)
+		{
+			if (fresh != NULL)
+				fresh[n_fresh] = ids[i];
+			n_fresh++;
+		}
+	}
+	return (n_fresh);
+}
+
+struct id_chunk
+{
+	pthread_t			thread;
+	uint64_t			*ids;
+	uint64_t			n_ids;
+	const struct range	*ranges;
+	uint64_t			n_ranges;
+	uint64_t			*fresh;
+	uint64_t			n_fresh;
+	bool				threaded;
+};
+
+void	*id_chunk_routine(void *arg)
+{
+	struct id_chunk	*chunk = arg;
+
+	radix_sort_ids(chunk->ids, chunk->n_ids);
+	chunk->n_fresh = merge_join_fresh(chunk->ids, chunk->n_ids, chunk->ranges, chunk->n_ranges, chunk->fresh);
+	return (NULL);
+}
+
+// Restores the min-heap of chunk indices, keyed on each chunk's next fresh
+// id, below slot i
+void	sift_down_chunks(struct id_chunk *chunks, uint64_t *heap, uint64_t size, uint64_t i)
+{
+	uint64_t	top = heap[i];
+	uint64_t	key = chunks[top].fresh[0];
+
+	while (2 * i + 1 < size)
+	{
+		uint64_t	child = 2 * i + 1;
+
+		if (child + 1 < size && chunks[heap[child + 1]].fresh[0] < chunks[heap[child]].fresh[0])
+			child++;
+		if (chunks[heap[child]].fresh[0] >= key)
+			break ;
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = top;
+}
+
+// K-way merge of the per-thread fresh lists through a heap of their heads,
+// O(n_fresh log n_threads). Consumes the chunks' fresh pointers.
+void	merge_fresh_lists(struct id_chunk *chunks, uint64_t n_threads, uint64_t *merged)
+{
+	uint64_t	*heap = malloc((n_threads + 1) * sizeof(uint64_t));
+	uint64_t	size = 0;
+
+	for (uint64_t t = 0; t < n_threads; t++)
+		if (chunks[t].n_fresh != 0)
+			heap[size++] = t;
+	for (uint64_t i = size / 2; i-- > 0; )
+		sift_down_chunks(chunks, heap, size, i);
+	while (size > 0)
+	{
+		struct id_chunk	*chunk = &chunks[heap[0]];
+
+		*merged++ = *chunk->fresh++;
+		if (--chunk->n_fresh == 0)
+			heap[0] = heap[--size];
+		if (size > 0)
+			sift_down_chunks(chunks, heap, size, 0);
+	}
+	free(heap);
+}
+
+// Bulk mode: each thread radix-sorts its share of the ids and merge-joins it
+// against the ranges on its own. If fresh_out is not NULL, the per-thread
+// fresh lists are merged into one ascending array returned there. A chunk
+// whose thread fails to start is checked inline instead.
+int	bulk_check_fresh(uint64_t *ids, uint64_t n_ids, const struct range *ranges, uint64_t n_ranges,
+		uint64_t n_threads, uint64_t *n_fresh_out, uint64_t **fresh_out)
+{
+	struct id_chunk	*chunks = calloc(n_threads, sizeof(struct id_chunk));
+	uint64_t		*fresh;
+	uint64_t		n_fresh = 0;
+
+	if (chunks == NULL)
+		return (printf("Too many threads\n"), 1);
+	fresh = fresh_out != NULL ? malloc((n_ids + 1) * sizeof(uint64_t)) : NULL;
+	for (uint64_t t = 0; t < n_threads; t++)
+	{
+		uint64_t	first = n_ids * t / n_threads;
+		uint64_t	last = n_ids * (t + 1) / n_threads;
+
+		chunks[t] = (struct id_chunk){
+			.ids = ids + first,
+			.n_ids = last - first,
+			.ranges = ranges,
+			.n_ranges = n_ranges,
+			.fresh = fresh != NULL ? fresh + first : NULL,
+		};
+		if (n_threads > 1)
+			chunks[t].threaded = pthread_create(&chunks[t].thread, NULL, id_chunk_routine, &chunks[t]) == 0;
+		if (!chunks[t].threaded)
+			id_chunk_routine(&chunks[t]);
+	}
+	for (uint64_t t = 0; t < n_threads; t++)
+	{
+		if (chunks[t].threaded)
+			pthread_join(chunks[t].thread, NULL);
+		n_fresh += chunks[t].n_fresh;
+	}
+
+	if (fresh_out != NULL)
+	{
+		uint64_t	*merged = malloc((n_fresh + 1) * sizeof(uint64_t));
+
+		merge_fresh_lists(chunks, n_threads, merged);
+		free(fresh);
+		*fresh_out = merged;
+	}
+	free(chunks);
+	*n_fresh_out = n_fresh;
+	return (0);
+}
+
+// Treap of disjoint intervals keyed on low. Every node keeps the number of
+// ids covered by its subtree, so the total is read off the root and updates
+// only touch the O(log n) nodes along their split paths.
+struct interval_node
+{
+	uint64_t				low;
+	uint64_t				high;
+	uint64_t				covered;
+	uint32_t				priority;
+	struct interval_node	*left;
+	struct interval_node	*right;
+};
+
+struct interval_node	*new_interval(uint64_t low, uint64_t high)
+{
+	struct interval_node	*new = malloc(sizeof(*new));
+
+	new->low = low;
+	new->high = high;
+	new->covered = high - low + 1;
+	new->priority = rand();
+	new->left = NULL;
+	new->right = NULL;
+	return (new);
+}
+
+void	update_covered(struct interval_node *node)
+{
+	node->covered = node->high - node->low + 1;
+	if (node->left != NULL)
+		node->covered += node->left->covered;
+	if (node->right != NULL)
+		node->covered += node->right->covered;
+}
+
+// Splits into nodes with low < key and nodes with low >= key
+void	interval_split(struct interval_node *node, uint64_t key,
+			struct interval_node **left, struct interval_node **right)
+{
+	if (node == NULL)
+	{
+		*left = NULL;
+		*right = NULL;
+	}
+	else if (node->low < key)
+	{
+		interval_split(node->right, key, &node->right, right);
+		update_covered(node);
+		*left = node;
+	}
+	else
+	{
+		interval_split(node->left, key, left, &node->left);
+		update_covered(node);
+		*right = node;
+	}
+}
+
+// Every low in left must be below every low in right
+struct interval_node	*interval_merge(struct interval_node *left, struct interval_node *right)
+{
+	if (left == NULL)
+		return (right);
+	if (right == NULL)
+		return (left);
+	if (left->priority > right->priority)
+	{
+		left->right = interval_merge(left->right, right);
+		update_covered(left);
+		return (left);
+	}
+	right->left = interval_merge(left, right->left);
+	update_covered(right);
+	return (right);
+}
+
+// Detaches and returns the node with the largest low
+struct interval_node	*interval_pop_max(struct interval_node **root)
+{
+	struct interval_node	*node = *root;
+	struct interval_node	*max;
+
+	if (node == NULL)
+		return (NULL);
+	if (node->right == NULL)
+	{
+		*root = node->left;
+		node->left = NULL;
+		update_covered(node);
+		return (node);
+	}
+	max = interval_pop_max(&node->right);
+	update_covered(node);
+	return (max);
+}
+
+void	free_intervals(struct interval_node *node)
+{
+	if (node == NULL)
+		return ;
+	free_intervals(node->left);
+	free_intervals(node->right);
+	free(node);
+}
+
+// Adds [low, high], coalescing it with every overlapping or adjacent interval
+void	interval_insert(struct interval_node **root, uint64_t low, uint64_t high)
+{
+	struct interval_node	*left;
+	struct interval_node	*mid;
+	struct interval_node	*right;
+	struct interval_node	*prev;
+
+	interval_split(*root, low, &left, &right);
+	prev = interval_pop_max(&left);
+	if (prev != NULL && prev->high < low - 1)
+		left = interval_merge(left, prev);
+	else if (prev != NULL)
+	{
+		low = prev->low;
+		if (prev->high > high)
+			high = prev->high;
+		free(prev);
+	}
+
+	// Intervals starting at high + 1 are adjacent, so they go in mid too
+	if (high >= UINT64_MAX - 1)
+	{
+		mid = right;
+		right = NULL;
+	}
+	else
+		interval_split(right, high + 2, &mid, &right);
+	prev = interval_pop_max(&mid);
+	if (prev != NULL && prev->high > high)
+		high = prev->high;
+	free(prev);
+	free_intervals(mid);
+
+	*root = interval_merge(interval_merge(left, new_interval(low, high)), right);
+}
+
+// Removes [low, high], trimming or splitting the intervals it overlaps
+void	interval_delete(struct interval_node **root, uint64_t low, uint64_t high)
+{
+	struct interval_node	*left;
+	struct interval_node	*mid;
+	struct interval_node	*right;
+	struct interval_node	*prev;
+	struct interval_node	*tail = NULL;
+
+	interval_split(*root, low, &left, &right);
+	prev = interval_pop_max(&left);
+	if (prev != NULL)
+	{
+		if (prev->high > high)
+			tail = new_interval(high + 1, prev->high);
+		if (prev->high >= low)
+			prev->high = low - 1;
+		update_covered(prev);
+		left = interval_merge(left, prev);
+	}
+
+	if (high == UINT64_MAX)
+	{
+		mid = right;
+		right = NULL;
+	}
+	else
+		interval_split(right, high + 1, &mid, &right);
+	prev = interval_pop_max(&mid);
+	if (prev != NULL && prev->high > high)
+		tail = new_interval(high + 1, prev->high);
+	free(prev);
+	free_intervals(mid);
+
+	*root = interval_merge(interval_merge(left, tail), right);
+}
+
+bool	interval_contains(struct interval_node *node, uint64_t id)
+{
+	while (node != NULL)
+	{
+		if (id < node->low)
+			node = node->left;
+		else if (id > node->high)
+			node = node->right;
+		else
+			return (true);
+	}
+	return (false);
+}
+
+uint64_t	interval_total(struct interval_node *root)
+{
+	return (root != NULL ? root->covered : 0);
+}
+
+// Applies a stream of updates, one per line: "+ low-high" inserts a range,
+// "- low-high" deletes one and "? id" queries an id.
+int	apply_updates(const char *path, struct interval_node **root)
+{
+	FILE		*fp = fopen(path, "r");
+	char		*line = NULL;
+	uint64_t	size = 0;
+
+	if (fp == NULL)
+		return (printf("Failed to open updates file\n"), 1);
+
+	while (getline(&line, &size, fp) != -1)
+	{
+		trim_nl(line);
+		if (line[0] == '\0')
+			continue ;
+		if (line[0] == '?')
+		{
+			uint64_t	id = parse_id(line + 1 + (line[1] == ' '));
+			if (errno != 0)
+				return (printf("Error parsing update: %s\n", line), free(line), fclose(fp), 1);
+			printf("%lu: %s\n", id, interval_contains(*root, id) ? "fresh" : "spoiled");
+			continue ;
+		}
+
+		struct range	range = parse_range(line + 1 + (line[1] == ' '));
+		if (errno != 0 || (line[0] != '+' && line[0] != '-'))
+			return (printf("Error parsing update: %s\n", line), free(line), fclose(fp), 1);
+		if (line[0] == '+')
+			interval_insert(root, range.low, range.high);
+		else
+			interval_delete(root, range.low, range.high);
+		printf("total fresh: %lu\n", interval_total(*root));
+	}
+	free(line);
+	fclose(fp);
+	return (0);
 }
 
 int	main(int argc, char **argv)
 {
-	if (argc != 2)
+	bool		bulk = false;
+	bool		verbose = false;
+	char		*updates_path = NULL;
+	uint64_t	n_threads = 0;
+	int			opt;
+	char		*endptr;
+
+	while ((opt = getopt(argc, argv, "svt:u:")) != -1)
+	{
+		if (opt == 's')
+			bulk = true;
+		else if (opt == 'v')
+			verbose = true;
+		else if (opt == 'u')
+			updates_path = optarg;
+		else if (opt == 't')
+		{
+			errno = 0;
+			n_threads = strtoul(optarg, &endptr, 10);
+			if (*endptr != '\0' || errno != 0 || n_threads == 0 || optarg[0] == '-')
+				return (printf("Error parsing thread count\n"), 1);
+			if (n_threads > (uint64_t)sysconf(_SC_NPROCESSORS_ONLN) * MAX_THREADS_PER_CORE)
+				n_threads = sysconf(_SC_NPROCESSORS_ONLN) * MAX_THREADS_PER_CORE;
+		}
+		else
+			return (printf("Usage: %s [-s] [-v] [-t threads] [-u updates] <file>\n", argv[0]), 1);
+	}
+	if (optind != argc - 1)
 		return (printf("No file provided\n"), 1);
 
-	FILE *fp = fopen(argv[1], "r");
+	FILE *fp = fopen(argv[optind], "r");
 	if (fp == NULL)
 		return (printf("Failed to open file\n"), 1);
 
@@ -184,8 +750,9 @@ int	main(int argc, char **argv)
 	uint64_t		ranges_size = 256;
 	struct range	*ranges = calloc(ranges_size, sizeof(struct range));
 	uint64_t		n_ranges = 0;
+	uint64_t		i = 0;
 
-	for (uint64_t i = 0; i < n_lines; i++)
+	for (; i < n_lines; i++)
 	{
 		// printf("\e[31m>\e[m %s\n", lines[i]);
 		if (!isdigit(lines[i][0]))
@@ -200,12 +767,70 @@ int	main(int argc, char **argv)
 			return (printf("Error!\n"), 1);
 	}
 
+	uint64_t	*ids = calloc(n_lines - i + 1, sizeof(uint64_t));
+	uint64_t	n_ids = 0;
+
+	for (; i < n_lines; i++)
+	{
+		if (lines[i][0] == '\0')
+			continue ;
+		ids[n_ids++] = parse_id(lines[i]);
+		if (errno != 0)
+			return (printf("Error!\n"), 1);
+	}
+
+	n_ranges = normalise_ranges(ranges, n_ranges);
 	fresh = calculate_total_fresh(ranges, n_ranges);
 
+	uint64_t	fresh_ids = 0;
+	int			status = 0;
+
+	if (bulk)
+	{
+		uint64_t	*fresh_list = NULL;
+
+		if (n_threads == 0)
+			n_threads = n_ids >= PARALLEL_MIN_IDS ? (uint64_t)sysconf(_SC_NPROCESSORS_ONLN) : 1;
+		status = bulk_check_fresh(ids, n_ids, ranges, n_ranges, n_threads, &fresh_ids,
+			verbose ? &fresh_list : NULL);
+		for (uint64_t j = 0; verbose && j < fresh_ids; j++)
+			printf("%lu\n", fresh_list[j]);
+		free(fresh_list);
+	}
+	else
+	{
+		struct range_index	index = build_range_index(ranges, n_ranges);
+		uint8_t				*flags = verbose ? malloc(n_ids + 1) : NULL;
+
+		fresh_ids = index_check_batch(&index, ids, n_ids, flags);
+		for (uint64_t j = 0; verbose && j < n_ids; j++)
+		{
+			if (flags[j])
+				printf("%lu\n", ids[j]);
+		}
+		free(flags);
+		free_range_index(&index);
+	}
+
 	// for (uint64_t i = 0; i < n_ranges; i++)
 	// 	printf("low: %lu high: %lu\n", ranges[i].low, ranges[i].high);
 
+	if (status != 0)
+		return (free_ptr_array((void **)lines, n_lines), free(ranges), free(ids), status);
+	printf("fresh ids: %lu\n", fresh_ids);
 	printf("total fresh: %lu\n", fresh);
+
+	if (updates_path != NULL)
+	{
+		struct interval_node	*set = NULL;
+
+		for (uint64_t j = 0; j < n_ranges; j++)
+			interval_insert(&set, ranges[j].low, ranges[j].high);
+		status = apply_updates(updates_path, &set);
+		free_intervals(set);
+	}
 	free_ptr_array((void **)lines, n_lines);
 	free(ranges);
+	free(ids);
+	return (status);
 }
@@ -6,149 +6,651 @@
 #include <string.h>
 #include <fcntl.h>
 #include <stdbool.h>
+#include <immintrin.h>
+#include <pthread.h>
+#include <unistd.h>
 
-void	trim_nl(char *line)
+// The whole worksheet as one row-major byte matrix, every row padded with
+// spaces to the widest line. The last row holds the operators.
+struct worksheet
 {
-	int32_t	len = strlen(line);
+	char		*cells;
+	uint64_t	n_rows;
+	uint64_t	width;
+};
 
-	if (line[len - 1] == '\n')
-		line[len - 1] = '\0';
-}
+struct problem
+{
+	uint64_t	first;
+	uint64_t	last;
+	char		op;
+};
 
-char	**read_lines(FILE *fp, uint64_t *n_lines)
+char	*read_file(FILE *fp, uint64_t *len)
 {
-	uint64_t	lines_size = 256;
-	char		**lines = calloc(lines_size, sizeof(char *));
-	uint64_t	len = 0;
-	uint64_t	i = 0;
+	uint64_t	size = 4096;
+	char		*buf = malloc(size);
+	uint64_t	n_read;
 
-	while (getline(&lines[i], &len, fp) != -1)
+	*len = 0;
+	while ((n_read = fread(buf + *len, 1, size - *len, fp)) > 0)
 	{
-		if (i == lines_size - 1)
+		*len += n_read;
+		if (*len == size)
 		{
-			lines_size *= 2;
-			lines = realloc(lines, lines_size * sizeof(char *));
-			memset(&lines[i + 1], 0, (lines_size - i - 1) * sizeof(char *));
+			size *= 2;
+			buf = realloc(buf, size);
 		}
-		trim_nl(lines[i]);
-		i++;
 	}
-	free(lines[i]);
-	lines = realloc(lines, i * sizeof(char *));
-	*n_lines = i;
-	return (lines);
+	return (buf);
 }
 
-void	align_num(char **num, char *line, char *op, char *op_line)
+struct worksheet	read_worksheet(FILE *fp)
 {
-	uint64_t	distance = op - op_line;
-	*num = line + distance;
+	struct worksheet	ws = {};
+	uint64_t			len;
+	char				*buf = read_file(fp, &len);
+	uint64_t			line_len = 0;
+
+	if (len > 0 && buf[len - 1] != '\n')
+		buf[len++] = '\n';
+	for (uint64_t i = 0; i < len; i++)
+	{
+		if (buf[i] != '\n')
+		{
+			line_len++;
+			continue ;
+		}
+		if (line_len > ws.width)
+			ws.width = line_len;
+		ws.n_rows++;
+		line_len = 0;
+	}
+
+	ws.cells = malloc(ws.n_rows * ws.width + 1);
+	memset(ws.cells, ' ', ws.n_rows * ws.width);
+
+	char	*line = buf;
+	for (uint64_t row = 0; row < ws.n_rows; row++)
+	{
+		char	*nl = memchr(line, '\n', buf + len - line);
+		memcpy(ws.cells + row * ws.width, line, nl - line);
+		line = nl + 1;
+	}
+	free(buf);
+	return (ws);
 }
 
-uint64_t	do_sum(char ***num_strs, uint64_t op_num, char op, uint64_t max_digits)
+void	assemble_columns_scalar(struct worksheet *ws, uint64_t *col_nums, uint8_t *blank,
+			uint8_t *n_digits, uint64_t first, uint64_t last)
 {
-	uint64_t	n_nums = 0;
-	uint64_t	result;
+	uint64_t	n_digit_rows = ws->n_rows - 1;
 
-	for (uint64_t i = 0; i < max_digits; i++)
+	for (uint64_t col = first; col < last; col++)
 	{
-		uint64_t len = strlen(num_strs[i][op_num]);
-		if (len  > n_nums)
-			n_nums = len;
+		col_nums[col] = 0;
+		n_digits[col] = 0;
+		blank[col] = ws->cells[n_digit_rows * ws->width + col] == ' ';
 	}
 
-	for (uint64_t i = 0; i < n_nums; i++)
+	for (uint64_t row = 0; row < n_digit_rows; row++)
 	{
-		uint64_t	num = 0;
-		for (uint64_t j = 0; j < max_digits; j++)
+		char	*cells = ws->cells + row * ws->width;
+		for (uint64_t col = first; col < last; col++)
 		{
-			char digit = num_strs[j][op_num][i];
-			if (isdigit(digit))
+			if (isdigit(cells[col]))
 			{
-				num *= 10;
-				num += digit - '0';
+				col_nums[col] = col_nums[col] * 10 + cells[col] - '0';
+				n_digits[col] += n_digits[col] < UINT8_MAX;
 			}
+			if (cells[col] != ' ')
+				blank[col] = 0;
+		}
+	}
+}
+
+#ifdef __AVX2__
+// Builds the numbers of 32 adjacent columns at once, walking down the rows
+// with one 64-bit accumulator lane per column. Each row slice is masked to
+// its digit bytes, and only those lanes take acc * 10 + digit. Digit counts
+// are kept per column in saturating bytes.
+void	assemble_block_avx2(struct worksheet *ws, uint64_t *col_nums, uint8_t *blank,
+			uint8_t *n_digits, uint64_t col)
+{
+	const __m256i	zero = _mm256_setzero_si256();
+	const __m256i	one = _mm256_set1_epi8(1);
+	const __m256i	nine = _mm256_set1_epi8(9);
+	const __m256i	space = _mm256_set1_epi8(' ');
+	uint64_t		n_digit_rows = ws->n_rows - 1;
+	__m256i			acc[8];
+	__m256i			used = zero;
+	__m256i			counts = zero;
+
+	for (int32_t k = 0; k < 8; k++)
+		acc[k] = zero;
+
+	for (uint64_t row = 0; row < n_digit_rows; row++)
+	{
+		__m256i	bytes = _mm256_loadu_si256((const __m256i *)(ws->cells + row * ws->width + col));
+		__m256i	digits = _mm256_sub_epi8(bytes, _mm256_set1_epi8('0'));
+		__m256i	is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digits, nine), digits);
+
+		used = _mm256_or_si256(used, _mm256_xor_si256(_mm256_cmpeq_epi8(bytes, space), _mm256_set1_epi8(-1)));
+		counts = _mm256_adds_epu8(counts, _mm256_and_si256(is_digit, one));
+		if (_mm256_testz_si256(is_digit, is_digit))
+			continue ;
+		digits = _mm256_and_si256(digits, is_digit);
+		__m128i	lo_digits = _mm256_castsi256_si128(digits);
+		__m128i	hi_digits = _mm256_extracti128_si256(digits, 1);
+		__m128i	lo_mask = _mm256_castsi256_si128(is_digit);
+		__m128i	hi_mask = _mm256_extracti128_si256(is_digit, 1);
+#define STEP(k, half_digits, half_mask, shift) \
+		do { \
+			__m256i	times_ten = _mm256_add_epi64(_mm256_slli_epi64(acc[k], 3), _mm256_slli_epi64(acc[k], 1)); \
+			__m256i	next = _mm256_add_epi64(times_ten, _mm256_cvtepu8_epi64(_mm_srli_si128(half_digits, shift))); \
+			acc[k] = _mm256_blendv_epi8(acc[k], next, _mm256_cvtepi8_epi64(_mm_srli_si128(half_mask, shift))); \
+		} while (0)
+		STEP(0, lo_digits, lo_mask, 0);
+		STEP(1, lo_digits, lo_mask, 4);
+		STEP(2, lo_digits, lo_mask, 8);
+		STEP(3, lo_digits, lo_mask, 12);
+		STEP(4, hi_digits, hi_mask, 0);
+		STEP(5, hi_digits, hi_mask, 4);
+		STEP(6, hi_digits, hi_mask, 8);
+		STEP(7, hi_digits, hi_mask, 12);
+#undef STEP
+	}
+
+	__m256i	ops = _mm256_loadu_si256((const __m256i *)(ws->cells + n_digit_rows * ws->width + col));
+	used = _mm256_or_si256(used, _mm256_xor_si256(_mm256_cmpeq_epi8(ops, space), _mm256_set1_epi8(-1)));
+	_mm256_storeu_si256((__m256i *)(blank + col),
+		_mm256_and_si256(_mm256_cmpeq_epi8(used, zero), one));
+	_mm256_storeu_si256((__m256i *)(n_digits + col), counts);
+	for (int32_t k = 0; k < 8; k++)
+		_mm256_storeu_si256((__m256i *)(col_nums + col + 4 * k), acc[k]);
+}
+#endif
+
+// Builds every column's number top to bottom and flags the all-space columns
+// that separate problems, 32 columns per AVX2 block with a scalar tail.
+// n_digits gets each column's digit count, saturating at UINT8_MAX.
+void	assemble_columns(struct worksheet *ws, uint64_t *col_nums, uint8_t *blank, uint8_t *n_digits)
+{
+	uint64_t	col = 0;
+
+#ifdef __AVX2__
+	for (; col + 32 <= ws->width; col += 32)
+		assemble_block_avx2(ws, col_nums, blank, n_digits, col);
+#endif
+	assemble_columns_scalar(ws, col_nums, blank, n_digits, col, ws->width);
+}
+
+uint64_t	find_problems(struct worksheet *ws, uint8_t *blank, struct problem *problems)
+{
+	char		*ops = ws->cells + (ws->n_rows - 1) * ws->width;
+	uint64_t	n_problems = 0;
+	uint64_t	col = 0;
+
+	while (col < ws->width)
+	{
+		while (col < ws->width && blank[col])
+			col++;
+		if (col == ws->width)
+			break ;
+
+		struct problem	*problem = &problems[n_problems++];
+		problem->first = col;
+		problem->op = ' ';
+		while (col < ws->width && !blank[col])
+		{
+			if (problem->op == ' ')
+				problem->op = ops[col];
+			col++;
 		}
-		if (i == 0)
-			result = num;
-		else if (op == '+')
-			result += num;
-		else if (op == '*')
-			result *= num;
+		problem->last = col;
 	}
-	printf("result: %lu\n", result);
-	return (result);
+	return (n_problems);
+}
+
+typedef unsigned __int128	t_u128;
+
+// Longest column number that always fits in a uint64_t
+#define MAX_COL_DIGITS 19
+
+// Little-endian base 2^64 unsigned integer, used once a result no longer
+// fits in 128 bits
+struct bignum
+{
+	uint64_t	*limbs;
+	uint64_t	n_limbs;
+	uint64_t	size;
+};
+
+// A running value kept in 128 bits until an operation would overflow, after
+// which it continues in a bignum
+struct wide
+{
+	t_u128			small;
+	struct bignum	big;
+	bool			promoted;
+};
+
+void	bignum_reserve(struct bignum *num, uint64_t n_limbs)
+{
+	if (n_limbs <= num->size)
+		return ;
+	while (num->size < n_limbs)
+		num->size = num->size == 0 ? 4 : num->size * 2;
+	num->limbs = realloc(num->limbs, num->size * sizeof(uint64_t));
 }
 
-void	free_ptr_array(void **lines, uint64_t n)
+void	bignum_set_u128(struct bignum *num, t_u128 value)
 {
+	bignum_reserve(num, 2);
+	num->limbs[0] = (uint64_t)value;
+	num->limbs[1] = (uint64_t)(value >> 64);
+	num->n_limbs = num->limbs[1] != 0 ? 2 : 1;
+}
+
+void	bignum_mul_u64(struct bignum *num, uint64_t factor)
+{
+	uint64_t	carry = 0;
+
+	for (uint64_t i = 0; i < num->n_limbs; i++)
+	{
+		t_u128	product = (t_u128)num->limbs[i] * factor + carry;
+		num->limbs[i] = (uint64_t)product;
+		carry = (uint64_t)(product >> 64);
+	}
+	if (carry != 0)
+	{
+		bignum_reserve(num, num->n_limbs + 1);
+		num->limbs[num->n_limbs++] = carry;
+	}
+	if (factor == 0)
+		num->n_limbs = 1;
+}
+
+void	bignum_add(struct bignum *num, const uint64_t *limbs, uint64_t n_limbs)
+{
+	uint64_t	carry = 0;
+	uint64_t	n = num->n_limbs > n_limbs ? num->n_limbs : n_limbs;
+
+	bignum_reserve(num, n + 1);
+	for (uint64_t i = num->n_limbs; i < n; i++)
+		num->limbs[i] = 0;
 	for (uint64_t i = 0; i < n; i++)
-		free(lines[i]);
-	free(lines);
+	{
+		t_u128	sum = (t_u128)num->limbs[i] + (i < n_limbs ? limbs[i] : 0) + carry;
+		num->limbs[i] = (uint64_t)sum;
+		carry = (uint64_t)(sum >> 64);
+	}
+	num->n_limbs = n;
+	if (carry != 0)
+		num->limbs[num->n_limbs++] = carry;
 }
 
-int	main(int argc, char **argv)
+// Schoolbook product of num and limbs
+void	bignum_mul(struct bignum *num, const uint64_t *limbs, uint64_t n_limbs)
 {
-	if (argc != 2)
-		return (printf("No file provided\n"), 1);
+	uint64_t	n = num->n_limbs + n_limbs;
+	uint64_t	*product = calloc(n + 1, sizeof(uint64_t));
 
-	FILE *fp = fopen(argv[1], "r");
-	if (fp == NULL)
-		return (printf("Failed to open file\n"), 1);
+	for (uint64_t i = 0; i < num->n_limbs; i++)
+	{
+		uint64_t	carry = 0;
+		for (uint64_t j = 0; j < n_limbs; j++)
+		{
+			t_u128	cur = (t_u128)num->limbs[i] * limbs[j] + product[i + j] + carry;
+			product[i + j] = (uint64_t)cur;
+			carry = (uint64_t)(cur >> 64);
+		}
+		product[i + n_limbs] = carry;
+	}
+	free(num->limbs);
+	num->limbs = product;
+	num->size = n + 1;
+	while (n > 1 && product[n - 1] == 0)
+		n--;
+	num->n_limbs = n;
+}
 
-	char		**lines = NULL;
-	uint64_t	n_lines = 0;
+void	print_u128(t_u128 value)
+{
+	char	buf[40];
+	int32_t	i = sizeof(buf) - 1;
 
-	lines = read_lines(fp, &n_lines);
-	fclose(fp);
+	buf[i] = '\0';
+	do
+	{
+		buf[--i] = '0' + value % 10;
+		value /= 10;
+	} while (value != 0);
+	printf("%s", buf + i);
+}
+
+void	bignum_print(const struct bignum *num)
+{
+	uint64_t	*limbs = malloc(num->n_limbs * sizeof(uint64_t));
+	uint64_t	n_limbs = num->n_limbs;
+	uint64_t	*chunks = malloc((num->n_limbs * 2 + 1) * sizeof(uint64_t));
+	uint64_t	n_chunks = 0;
+
+	memcpy(limbs, num->limbs, n_limbs * sizeof(uint64_t));
+	while (n_limbs > 0)
+	{
+		uint64_t	rem = 0;
+		for (uint64_t i = n_limbs; i-- > 0;)
+		{
+			t_u128	cur = ((t_u128)rem << 64) | limbs[i];
+			limbs[i] = (uint64_t)(cur / 10000000000000000000UL);
+			rem = (uint64_t)(cur % 10000000000000000000UL);
+		}
+		chunks[n_chunks++] = rem;
+		while (n_limbs > 0 && limbs[n_limbs - 1] == 0)
+			n_limbs--;
+	}
+	if (n_chunks == 0)
+		chunks[n_chunks++] = 0;
+	printf("%lu", chunks[n_chunks - 1]);
+	while (--n_chunks > 0)
+		printf("%019lu", chunks[n_chunks - 1]);
+	free(limbs);
+	free(chunks);
+}
+
+void	wide_promote(struct wide *value)
+{
+	if (value->promoted)
+		return ;
+	bignum_set_u128(&value->big, value->small);
+	value->promoted = true;
+}
+
+void	wide_add_u128(struct wide *value, t_u128 term)
+{
+	t_u128	sum;
 
-	// for (uint64_t i = 0; i < n_lines; i++)
-	// {
-	// 	printf("\e[31m>\e[m %s\n", lines[i]);
-	// }
-	uint64_t	opbuf_size = 256;
-	char		**ops = calloc(opbuf_size, sizeof(char *));
-	uint64_t	n_ops = 0;
-	char		*token = strtok(lines[n_lines - 1], " \t\n");
-	while (token != NULL)
-	{
-		if (n_ops == opbuf_size)
+	if (!value->promoted && !__builtin_add_overflow(value->small, term, &sum))
+	{
+		value->small = sum;
+		return ;
+	}
+	wide_promote(value);
+	uint64_t	limbs[2] = {(uint64_t)term, (uint64_t)(term >> 64)};
+	bignum_add(&value->big, limbs, 2);
+}
+
+void	wide_add(struct wide *value, const struct wide *term)
+{
+	if (!term->promoted)
+		wide_add_u128(value, term->small);
+	else
+	{
+		wide_promote(value);
+		bignum_add(&value->big, term->big.limbs, term->big.n_limbs);
+	}
+}
+
+void	wide_mul_u64(struct wide *value, uint64_t factor)
+{
+	t_u128	product;
+
+	if (!value->promoted && !__builtin_mul_overflow(value->small, factor, &product))
+	{
+		value->small = product;
+		return ;
+	}
+	wide_promote(value);
+	bignum_mul_u64(&value->big, factor);
+}
+
+void	wide_mul(struct wide *value, const struct wide *term)
+{
+	t_u128	product;
+
+	if (!term->promoted && term->small >> 64 == 0)
+		return (wide_mul_u64(value, (uint64_t)term->small));
+	if (!value->promoted && !term->promoted && !__builtin_mul_overflow(value->small, term->small, &product))
+	{
+		value->small = product;
+		return ;
+	}
+	wide_promote(value);
+	if (term->promoted)
+		bignum_mul(&value->big, term->big.limbs, term->big.n_limbs);
+	else
+	{
+		uint64_t	limbs[2] = {(uint64_t)term->small, (uint64_t)(term->small >> 64)};
+		bignum_mul(&value->big, limbs, 2);
+	}
+}
+
+void	wide_print(const struct wide *value)
+{
+	if (value->promoted)
+		bignum_print(&value->big);
+	else
+		print_u128(value->small);
+}
+
+void	wide_free(struct wide *value)
+{
+	free(value->big.limbs);
+}
+
+// Columns with more digits than a uint64_t holds (MAX_COL_DIGITS) wrap in
+// the fast assembly, so tall worksheets rebuild those columns as wide
+// values, using the digit counts from assemble_columns. Returns NULL when
+// no column is that long.
+struct wide	**assemble_long_columns(struct worksheet *ws, uint8_t *n_digits)
+{
+	uint64_t	n_digit_rows = ws->n_rows - 1;
+	uint64_t	n_long = 0;
+	struct wide	**long_nums = NULL;
+
+	if (n_digit_rows <= MAX_COL_DIGITS)
+		return (NULL);
+	for (uint64_t col = 0; col < ws->width; col++)
+	{
+		if (n_digits[col] <= MAX_COL_DIGITS)
+			continue ;
+		if (long_nums == NULL)
+			long_nums = calloc(ws->width, sizeof(struct wide *));
+
+		struct wide	*num = calloc(1, sizeof(struct wide));
+		for (uint64_t row = 0; row < n_digit_rows; row++)
 		{
-			opbuf_size *= 2;
-			ops = realloc(ops, opbuf_size * sizeof(char *));
+			char	cell = ws->cells[row * ws->width + col];
+			if (!isdigit(cell))
+				continue ;
+			wide_mul_u64(num, 10);
+			wide_add_u128(num, cell - '0');
 		}
-		ops[n_ops++] = token;
-		// printf("<%s>\n", token);
-		token = strtok(NULL, " \t\n");
+		long_nums[col] = num;
+		n_long++;
+	}
+	if (n_long > 0)
+		printf("%lu columns over %d digits assembled past 64 bits\n", n_long, MAX_COL_DIGITS);
+	return (long_nums);
+}
+
+void	free_long_columns(struct wide **long_nums, uint64_t width)
+{
+	if (long_nums == NULL)
+		return ;
+	for (uint64_t col = 0; col < width; col++)
+	{
+		if (long_nums[col] == NULL)
+			continue ;
+		wide_free(long_nums[col]);
+		free(long_nums[col]);
 	}
+	free(long_nums);
+}
 
-	char		***num_strs = calloc(n_lines - 1, sizeof(char **));
+void	do_sum(uint64_t *col_nums, struct wide **long_nums, struct problem *problem, struct wide *result)
+{
+	*result = (struct wide){};
 
-	for (uint64_t i = 0; i < n_lines - 1; i++)
+	for (uint64_t i = problem->first; i < problem->last; i++)
 	{
-		uint64_t	j = 0;
-		num_strs[i] = calloc(n_ops, sizeof(char *));
+		struct wide	*long_num = long_nums != NULL ? long_nums[i] : NULL;
 
-		token = strtok(lines[i], " \t\n");
-		while (token != NULL && j < n_ops)
+		if (i == problem->first || problem->op == '+')
 		{
-			align_num(&token, lines[i], ops[j], lines[n_lines - 1]);
-			if (j < 8)
-				printf("%s\t", token);
-			num_strs[i][j++] = token;
-			token = strtok(NULL, " \t\n");
+			if (long_num != NULL)
+				wide_add(result, long_num);
+			else
+				wide_add_u128(result, col_nums[i]);
+		}
+		else if (problem->op == '*')
+		{
+			if (long_num != NULL)
+				wide_mul(result, long_num);
+			else
+				wide_mul_u64(result, col_nums[i]);
 		}
-		printf("\n");
 	}
+}
+
+// A contiguous slice of the problem list evaluated by one worker, with its
+// partial total and the indices of the problems that needed promotion
+// Upper bound on worker threads per online core for an explicit count
+#define MAX_THREADS_PER_CORE 4
 
-	uint64_t	total = 0;
-	for (uint64_t i = 0; i < n_ops; i++)
+struct slice
+{
+	pthread_t		thread;
+	uint64_t		*col_nums;
+	struct wide		**long_nums;
+	struct problem	*problems;
+	uint64_t		first;
+	uint64_t		last;
+	struct wide		total;
+	uint64_t		*promoted;
+	uint64_t		n_promoted;
+	uint64_t		promoted_size;
+	bool			threaded;
+};
+
+void	*slice_routine(void *arg)
+{
+	struct slice	*slice = arg;
+	struct wide		result = {};
+
+	for (uint64_t i = slice->first; i < slice->last; i++)
 	{
-		total += do_sum(num_strs, i, *(ops[i]), n_lines - 1);
+		do_sum(slice->col_nums, slice->long_nums, &slice->problems[i], &result);
+		if (result.promoted)
+		{
+			if (slice->n_promoted == slice->promoted_size)
+			{
+				slice->promoted_size = slice->promoted_size == 0 ? 16 : slice->promoted_size * 2;
+				slice->promoted = realloc(slice->promoted, slice->promoted_size * sizeof(uint64_t));
+			}
+			slice->promoted[slice->n_promoted++] = i;
+		}
+		wide_add(&slice->total, &result);
+		wide_free(&result);
 	}
+	return (NULL);
+}
+
+// Splits the problems across n_threads workers and reduces their totals in
+// order, so promotion reports keep the problem order. A slice whose thread
+// fails to start is evaluated inline instead.
+int	evaluate_problems(uint64_t *col_nums, struct wide **long_nums, struct problem *problems,
+			uint64_t n_problems, uint64_t n_threads, struct wide *total)
+{
+	struct slice	*slices = calloc(n_threads, sizeof(struct slice));
 
-	printf("Total: %lu\n", total);
-	free_ptr_array((void **)lines, n_lines);
-	free_ptr_array((void **)num_strs, n_lines - 1);
-	free(ops);
+	if (slices == NULL)
+		return (printf("Too many threads\n"), 1);
+	for (uint64_t t = 0; t < n_threads; t++)
+	{
+		slices[t].col_nums = col_nums;
+		slices[t].long_nums = long_nums;
+		slices[t].problems = problems;
+		slices[t].first = n_problems * t / n_threads;
+		slices[t].last = n_problems * (t + 1) / n_threads;
+		slices[t].threaded = pthread_create(&slices[t].thread, NULL, slice_routine, &slices[t]) == 0;
+		if (!slices[t].threaded)
+			slice_routine(&slices[t]);
+	}
+	for (uint64_t t = 0; t < n_threads; t++)
+	{
+		if (slices[t].threaded)
+			pthread_join(slices[t].thread, NULL);
+		for (uint64_t i = 0; i < slices[t].n_promoted; i++)
+		{
+			struct problem	*problem = &problems[slices[t].promoted[i]];
+			printf("problem %lu (columns %lu-%lu) promoted past 128 bits\n",
+				slices[t].promoted[i], problem->first, problem->last - 1);
+		}
+		wide_add(total, &slices[t].total);
+		wide_free(&slices[t].total);
+		free(slices[t].promoted);
+	}
+	free(slices);
+	return (0);
+}
+
+int	main(int argc, char **argv)
+{
+	if (argc < 2)
+		return (printf("No file provided\n"), 1);
+
+	uint64_t	n_threads = 0;
+	if (argc > 2)
+	{
+		char *endptr;
+		errno = 0;
+		n_threads = strtoul(argv[2], &endptr, 10);
+		if (*endptr != '\0' || errno != 0 || argv[2][0] == '-')
+			return (printf("Error parsing thread count\n"), 1);
+	}
+	uint64_t	n_cores = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n_threads == 0)
+		n_threads = n_cores;
+	if (n_threads > n_cores * MAX_THREADS_PER_CORE)
+		n_threads = n_cores * MAX_THREADS_PER_CORE;
+
+	FILE *fp = fopen(argv[1], "r");
+	if (fp == NULL)
+		return (printf("Failed to open file\n"), 1);
+
+	struct worksheet	ws = read_worksheet(fp);
+	fclose(fp);
+	if (ws.n_rows < 2)
+		return (free(ws.cells), printf("Worksheet has no numbers\n"), 1);
+
+	uint64_t		*col_nums = malloc(ws.width * sizeof(uint64_t));
+	uint8_t			*blank = malloc(ws.width);
+	uint8_t			*n_digits = malloc(ws.width);
+	struct problem	*problems = malloc((ws.width / 2 + 1) * sizeof(struct problem));
+
+	assemble_columns(&ws, col_nums, blank, n_digits);
+	struct wide	**long_nums = assemble_long_columns(&ws, n_digits);
+	uint64_t	n_problems = find_problems(&ws, blank, problems);
+
+	struct wide	total = {};
+	if (n_threads > n_problems)
+		n_threads = n_problems > 0 ? n_problems : 1;
+	int	status = evaluate_problems(col_nums, long_nums, problems, n_problems, n_threads, &total);
+
+	if (status == 0)
+	{
+		printf("Total: ");
+		wide_print(&total);
+		printf("\n");
+	}
+	wide_free(&total);
+	free(ws.cells);
+	free(col_nums);
+	free_long_columns(long_nums, ws.width);
+	free(blank);
+	free(n_digits);
+	free(problems);
+	return (status);
 }
@@ -1,13 +1,13 @@
-#include <bits/types/struct_timeval.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
-#include <fcntl.h>
 #include <sys/types.h>
-#include <sys/time.h>
 #include <unistd.h>
 #include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <immintrin.h>
 
 void	trim_nl(char *line)
 {
@@ -48,56 +48,325 @@ void	free_ptr_array(void **lines, uint64_t n)
 	free(lines);
 }
 
-uint64_t	process_line(char **lines, uint64_t lineno)
+#define ROW_PAD 4
+#define MAX_MODULUS (1UL << 62)
+
+typedef unsigned __int128	t_u128;
+
+// Rolling state for streaming propagation. cur, next and row are padded by
+// ROW_PAD cells on the left and rounded up to whole vectors plus ROW_PAD on
+// the right, so the kernel can load the cells either side of any vector.
+// Padding count cells stay zero and padding row cells past the right edge
+// are splitters, which makes beams spilling off the edge disappear.
+// Counts start in 64-bit lanes and move to the 128-bit rows (wide) once the
+// row total could overflow; with a modulus they stay reduced in 64 bits.
+// reached flags the cells any beam gets to, since a reduced count of zero
+// does not mean no beam arrived.
+struct beam_rows
+{
+	uint64_t	*cur;
+	uint64_t	*next;
+	uint8_t		*reached;
+	uint8_t		*next_reached;
+	t_u128		*cur_wide;
+	t_u128		*next_wide;
+	char		*row;
+	uint64_t	width;
+	uint64_t	n_cols;
+	uint64_t	modulus;
+	bool		wide;
+	bool		overflow;
+	t_u128		total;
+};
+
+void	*alloc_padded(uint64_t n, uint64_t elem_size)
+{
+	uint64_t	size = (n * elem_size + 31) & ~31UL;
+	char		*mem = aligned_alloc(32, size);
+
+	memset(mem, 0, size);
+	return (mem + ROW_PAD * elem_size);
+}
+
+struct beam_rows	new_beam_rows(uint64_t width, uint64_t modulus)
+{
+	struct beam_rows	rows = {.width = width, .modulus = modulus};
+	uint64_t			n_alloc;
+
+	rows.n_cols = (width + 3) & ~3UL;
+	n_alloc = rows.n_cols + 2 * ROW_PAD;
+	rows.cur = alloc_padded(n_alloc, sizeof(uint64_t));
+	rows.next = alloc_padded(n_alloc, sizeof(uint64_t));
+	rows.reached = alloc_padded(n_alloc, sizeof(uint8_t));
+	rows.next_reached = alloc_padded(n_alloc, sizeof(uint8_t));
+	rows.row = malloc(n_alloc) + ROW_PAD;
+	return (rows);
+}
+
+void	free_beam_rows(struct beam_rows *rows)
+{
+	free(rows->cur - ROW_PAD);
+	free(rows->next - ROW_PAD);
+	free(rows->reached - ROW_PAD);
+	free(rows->next_reached - ROW_PAD);
+	if (rows->wide)
+	{
+		free(rows->cur_wide - ROW_PAD);
+		free(rows->next_wide - ROW_PAD);
+	}
+	free(rows->row - ROW_PAD);
+}
+
+void	promote_beam_rows(struct beam_rows *rows)
+{
+	uint64_t	n_alloc = rows->n_cols + 2 * ROW_PAD;
+
+	rows->cur_wide = alloc_padded(n_alloc, sizeof(t_u128));
+	rows->next_wide = alloc_padded(n_alloc, sizeof(t_u128));
+	for (uint64_t i = 0; i < rows->n_cols; i++)
+		rows->cur_wide[i] = rows->cur[i];
+	rows->wide = true;
+}
+
+void	load_row(struct beam_rows *rows, const char *line)
+{
+	uint64_t	len = strnlen(line, rows->width);
+
+	memset(rows->row - ROW_PAD, '.', ROW_PAD);
+	memcpy(rows->row, line, len);
+	memset(rows->row + len, '.', rows->width - len);
+	memset(rows->row + rows->width, '^', rows->n_cols - rows->width + ROW_PAD);
+}
+
+#ifdef __AVX2__
+// All-ones 64-bit lanes where the 4 row cells at p are splitters
+__m256i	splitter_mask(const char *p)
 {
-	uint64_t	n_splits = 0;
-	char		*cur_line = lines[lineno];
-	char		*next_line = lines[lineno + 1];
+	int32_t	cells;
+
+	memcpy(&cells, p, sizeof(cells));
+	return (_mm256_cvtepi8_epi64(_mm_cmpeq_epi8(_mm_cvtsi32_si128(cells), _mm_set1_epi8('^'))));
+}
+
+// Subtracts p from the lanes that are >= p, for lanes below 2^63
+__m256i	reduce_mod(__m256i vec, __m256i p, __m256i p_minus_one)
+{
+	return (_mm256_sub_epi64(vec, _mm256_and_si256(_mm256_cmpgt_epi64(vec, p_minus_one), p)));
+}
+#endif
+
+uint64_t	add_mod(uint64_t a, uint64_t b, uint64_t modulus)
+{
+	uint64_t	sum = a + b;
+
+	if (modulus != 0 && sum >= modulus)
+		sum -= modulus;
+	return (sum);
+}
+
+// Every cell takes its own count unless it is a splitter, plus whatever the
+// splitters either side of it shed; a splitter cell itself ends up empty.
+void	propagate_u64(struct beam_rows *rows, uint64_t *total)
+{
+	const uint64_t	*cur = rows->cur;
+	uint64_t		*next = rows->next;
+	const char		*row = rows->row;
+	uint64_t		modulus = rows->modulus;
+	uint64_t		i = 0;
+
+	*total = 0;
+#ifdef __AVX2__
+	const __m256i	p = _mm256_set1_epi64x(modulus);
+	const __m256i	p_minus_one = _mm256_set1_epi64x(modulus - 1);
+	__m256i			row_total = _mm256_setzero_si256();
 
-	for (uint64_t i = 0; cur_line[i] != '\0'; i++)
+	for (; i < rows->n_cols; i += 4)
 	{
-		if (cur_line[i] == 'S' || cur_line[i] == '|')
+		__m256i	mask = splitter_mask(row + i);
+		__m256i	count = _mm256_load_si256((const __m256i *)(cur + i));
+		__m256i	from_left = _mm256_and_si256(splitter_mask(row + i - 1),
+					_mm256_loadu_si256((const __m256i *)(cur + i - 1)));
+		__m256i	from_right = _mm256_and_si256(splitter_mask(row + i + 1),
+					_mm256_loadu_si256((const __m256i *)(cur + i + 1)));
+		__m256i	sum = _mm256_add_epi64(count, from_left);
+
+		if (modulus != 0)
+			sum = reduce_mod(sum, p, p_minus_one);
+		sum = _mm256_add_epi64(sum, from_right);
+		if (modulus != 0)
+			sum = reduce_mod(sum, p, p_minus_one);
+		sum = _mm256_andnot_si256(mask, sum);
+		_mm256_store_si256((__m256i *)(next + i), sum);
+		row_total = _mm256_add_epi64(row_total, sum);
+	}
+	uint64_t	lanes[4];
+	_mm256_storeu_si256((__m256i *)lanes, row_total);
+	*total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+	for (; i < rows->n_cols; i++)
+	{
+		if (row[i] == '^')
 		{
-			if (next_line[i] != '^')
-				next_line[i] = '|';
-			else
-			{
-				n_splits++;
-				if (i > 0)
-					next_line[i - 1] = '|';
-				if (next_line[i + 1] != '\0')
-					next_line[i + 1] = '|';
-			}
+			next[i] = 0;
+			continue ;
 		}
+		next[i] = cur[i];
+		if (row[i - 1] == '^')
+			next[i] = add_mod(next[i], cur[i - 1], modulus);
+		if (row[i + 1] == '^')
+			next[i] = add_mod(next[i], cur[i + 1], modulus);
+		*total += next[i];
 	}
-	return (n_splits);
 }
 
-void	process_converted_line(int64_t **arr, uint64_t lineno, uint64_t linelen)
+void	propagate_u128(struct beam_rows *rows, t_u128 *total)
 {
-	int64_t	*cur_line = arr[lineno];
-	int64_t	*next_line = arr[lineno + 1];
+	const t_u128	*cur = rows->cur_wide;
+	t_u128			*next = rows->next_wide;
+	const char		*row = rows->row;
 
-	for (uint64_t i = 0; i < linelen; i++)
+	*total = 0;
+	for (uint64_t i = 0; i < rows->n_cols; i++)
 	{
-		if (cur_line[i] > 0)
+		if (row[i] == '^')
 		{
-			int64_t num = cur_line[i];
-			if (next_line[i] >= 0)
-				next_line[i] += num;
-			else
-			{
-				if (i > 0)
-					next_line[i - 1] += num;
-				if (i + 1 < linelen)
-					next_line[i + 1] += num;
-			}
+			next[i] = 0;
+			continue ;
+		}
+		next[i] = cur[i] + (row[i - 1] == '^' ? cur[i - 1] : 0) + (row[i + 1] == '^' ? cur[i + 1] : 0);
+		rows->overflow |= next[i] < cur[i] || __builtin_add_overflow(*total, next[i], total);
+	}
+}
+
+// Same rule as the counts on 0/1 reached flags, which never wrap. Returns the
+// number of splitters hit, i.e. reached by any beam.
+uint64_t	propagate_reached(struct beam_rows *rows)
+{
+	const uint8_t	*cur = rows->reached;
+	uint8_t			*next = rows->next_reached;
+	const char		*row = rows->row;
+	uint64_t		n_splits = 0;
+	uint64_t		i = 0;
+
+#ifdef __AVX2__
+	const __m256i	splitter = _mm256_set1_epi8('^');
+
+	for (; i + 32 <= rows->n_cols; i += 32)
+	{
+		__m256i	mask = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(row + i)), splitter);
+		__m256i	mask_left = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(row + i - 1)), splitter);
+		__m256i	mask_right = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(row + i + 1)), splitter);
+		__m256i	here = _mm256_loadu_si256((const __m256i *)(cur + i));
+		__m256i	from_left = _mm256_and_si256(mask_left, _mm256_loadu_si256((const __m256i *)(cur + i - 1)));
+		__m256i	from_right = _mm256_and_si256(mask_right, _mm256_loadu_si256((const __m256i *)(cur + i + 1)));
+		__m256i	hit = _mm256_cmpeq_epi8(_mm256_and_si256(mask, here), _mm256_setzero_si256());
+
+		n_splits += __builtin_popcount(~(uint32_t)_mm256_movemask_epi8(hit));
+		_mm256_storeu_si256((__m256i *)(next + i),
+			_mm256_andnot_si256(mask, _mm256_or_si256(here, _mm256_or_si256(from_left, from_right))));
+	}
+#endif
+	for (; i < rows->n_cols; i++)
+	{
+		if (row[i] == '^')
+		{
+			n_splits += cur[i];
+			next[i] = 0;
+			continue ;
 		}
+		next[i] = cur[i] | (row[i - 1] == '^' && cur[i - 1]) | (row[i + 1] == '^' && cur[i + 1]);
+	}
+	return (n_splits);
+}
+
+// Moves the beam counts in rows->cur through rows->row into rows->next and
+// swaps them. No single count can exceed the row total, and a row at most
+// doubles the total, so 64-bit lanes are safe while the total is below half
+// the range; past that the counts continue in 128 bits.
+uint64_t	propagate_row(struct beam_rows *rows)
+{
+	uint64_t	n_splits;
+	uint64_t	n_sources = 0;
+
+	if (!rows->wide && rows->modulus == 0 && rows->total > (UINT64_MAX - rows->width) / 2)
+		promote_beam_rows(rows);
+
+	n_splits = propagate_reached(rows);
+	if (rows->wide)
+	{
+		t_u128	total;
+		propagate_u128(rows, &total);
+		rows->total = total;
+	}
+	else
+	{
+		uint64_t	total;
+		propagate_u64(rows, &total);
+		rows->total = total;
+	}
+
+	const char	*source = rows->row;
+	while ((source = memchr(source, 'S', rows->width - (source - rows->row))) != NULL)
+	{
+		uint64_t	i = source++ - rows->row;
+		rows->next_reached[i] = 1;
+		if (rows->wide)
+			rows->next_wide[i] += 1;
+		else
+			rows->next[i] = add_mod(rows->next[i], 1, rows->modulus);
+		n_sources++;
+	}
+	rows->overflow |= __builtin_add_overflow(rows->total, n_sources, &rows->total);
+
+	uint64_t	*tmp = rows->cur;
+	rows->cur = rows->next;
+	rows->next = tmp;
+	t_u128		*tmp_wide = rows->cur_wide;
+	rows->cur_wide = rows->next_wide;
+	rows->next_wide = tmp_wide;
+	uint8_t		*tmp_reached = rows->reached;
+	rows->reached = rows->next_reached;
+	rows->next_reached = tmp_reached;
+	return (n_splits);
+}
+
+// Writes value in decimal into the end of buf and returns the first digit
+char	*format_u128(t_u128 value, char buf[40])
+{
+	int32_t	i = 39;
+
+	buf[i] = '\0';
+	do
+	{
+		buf[--i] = '0' + value % 10;
+		value /= 10;
+	} while (value != 0);
+	return (buf + i);
+}
+
+bool	parse_u128(const char *str, t_u128 *out)
+{
+	t_u128	value = 0;
+
+	if (*str == '\0')
+		return (false);
+	for (; *str != '\0'; str++)
+	{
+		if (*str < '0' || *str > '9')
+			return (false);
+		if (__builtin_mul_overflow(value, 10, &value) || __builtin_add_overflow(value, *str - '0', &value))
+			return (false);
 	}
+	*out = value;
+	return (true);
 }
 
-void	print_path(int fd, char **lines, uint64_t *pos_arr, uint64_t n_lines, uint64_t paths)
+// Draws the beam position after each row over the grid; rows above the
+// timeline's source have no position (UINT64_MAX).
+void	print_path(int fd, char **lines, uint64_t *pos_arr, uint64_t n_lines, t_u128 index)
 {
+	char	buf[40];
+
 	for (uint64_t i = 0; i < n_lines; i++)
 	{
 		for (uint64_t j = 0; lines[i][j] != '\0'; j++)
@@ -109,118 +378,446 @@ void	print_path(int fd, char **lines, uint64_t *pos_arr, uint64_t n_lines, uint6
 		}
 		dprintf(fd, "\n");
 	}
-	dprintf(fd, "paths: %lu\n\n", paths);
+	dprintf(fd, "timeline: %s\n\n", format_u128(index, buf));
 }
 
-struct data
+// suffix[r * width + c] holds the number of timelines that finish from a beam
+// sitting in column c after row r, so any single timeline can be walked
+// top-down by choosing a branch at each splitter without visiting the rest.
+// Timelines are ordered by source (row, then column), then left before right.
+struct timeline_table
 {
-	char			**lines;
-	uint64_t		n_lines;
-	uint64_t		n_paths;
-	int				logfd;
-	struct timeval	start;
+	char		**lines;
+	uint64_t	n_lines;
+	uint64_t	width;
+	t_u128		*suffix;
+	t_u128		total;
+	bool		overflow;
 };
 
-void	log_path(struct data *data)
+char	grid_cell(struct timeline_table *table, uint64_t row, uint64_t col)
 {
-	struct timeval time;
+	return (table->lines[row][col]);
+}
+
+// Whether a beam split off a splitter in row lands in col, rather than
+// falling off the edge or onto a neighbouring splitter
+bool	can_land(struct timeline_table *table, uint64_t row, int64_t col)
+{
+	return (col >= 0 && (uint64_t)col < table->width && grid_cell(table, row, col) != '^');
+}
 
-	gettimeofday(&time, NULL);
+struct timeline_table	build_timeline_table(char **lines, uint64_t n_lines)
+{
+	struct timeline_table	table = {.lines = lines, .n_lines = n_lines};
+	uint64_t				width;
 
-	uint64_t	secs = time.tv_sec - data->start.tv_sec;
-	uint64_t	usecs;
-	if (time.tv_usec < data->start.tv_usec)
+	// Rows are cut or padded to the first row's width, as when streaming
+	width = table.width = strlen(lines[0]);
+	for (uint64_t r = 0; r < n_lines; r++)
 	{
-		secs--;
-		usecs = time.tv_usec + (1000000 - data->start.tv_usec);
+		uint64_t	len = strnlen(lines[r], width);
+
+		lines[r] = realloc(lines[r], width + 1);
+		memset(lines[r] + len, '.', width - len);
+		lines[r][width] = '\0';
 	}
-	else
-		usecs = time.tv_usec - data->start.tv_usec;
+	table.suffix = malloc(n_lines * width * sizeof(t_u128));
+	for (uint64_t c = 0; c < width; c++)
+		table.suffix[(n_lines - 1) * width + c] = 1;
+	for (int64_t r = n_lines - 2; r >= 0; r--)
+	{
+		t_u128	*below = table.suffix + (r + 1) * width;
+		t_u128	*cur = table.suffix + r * width;
 
-	dprintf(data->logfd, "%10lu.%03lu  paths: %lu\n", secs, usecs / 1000, data->n_paths);
+		for (int64_t c = 0; (uint64_t)c < width; c++)
+		{
+			if (grid_cell(&table, r + 1, c) != '^')
+			{
+				cur[c] = below[c];
+				continue ;
+			}
+			cur[c] = 0;
+			if (can_land(&table, r + 1, c - 1))
+				cur[c] = below[c - 1];
+			if (can_land(&table, r + 1, c + 1))
+				table.overflow |= __builtin_add_overflow(cur[c], below[c + 1], &cur[c]);
+		}
+	}
+	for (uint64_t r = 0; r < n_lines; r++)
+		for (uint64_t c = 0; c < width; c++)
+			if (grid_cell(&table, r, c) == 'S')
+				table.overflow |= __builtin_add_overflow(table.total, table.suffix[r * width + c], &table.total);
+	return (table);
 }
 
-void	follow_path(struct data *data, uint64_t pos, uint64_t lineno)
+// Fills pos_arr with the beam column after every row of timeline k (< total)
+void	nth_timeline(struct timeline_table *table, t_u128 k, uint64_t *pos_arr)
 {
-	while (lineno < data->n_lines && data->lines[lineno][pos] != '^')
-		lineno++;
-	if (lineno == data->n_lines)
+	uint64_t	width = table->width;
+	uint64_t	row = 0;
+	uint64_t	col = 0;
+
+	for (; row < table->n_lines; row++)
 	{
-		data->n_paths++;
-		log_path(data);
-		return ;
+		for (col = 0; col < width; col++)
+		{
+			if (grid_cell(table, row, col) != 'S')
+				continue ;
+			if (k < table->suffix[row * width + col])
+				break ;
+			k -= table->suffix[row * width + col];
+		}
+		if (col < width)
+			break ;
+		pos_arr[row] = UINT64_MAX;
 	}
+	pos_arr[row] = col;
+	while (++row < table->n_lines)
+	{
+		if (grid_cell(table, row, col) == '^')
+		{
+			t_u128	left = 0;
 
-	if (pos > 0)
-		follow_path(data, pos - 1, lineno);
-	if (data->lines[lineno][pos + 1] != '\0')
-		follow_path(data, pos + 1, lineno);
+			if (can_land(table, row, (int64_t)col - 1))
+				left = table->suffix[row * width + col - 1];
+			if (k < left)
+				col--;
+			else
+			{
+				k -= left;
+				col++;
+			}
+		}
+		pos_arr[row] = col;
+	}
 }
 
-int64_t	**convert_lines(char **lines, uint64_t n_lines)
+uint64_t	splitmix64(uint64_t *state)
 {
-	int64_t	**converted = calloc(n_lines, sizeof(uint64_t *));
+	uint64_t	z = (*state += 0x9e3779b97f4a7c15UL);
 
-	for (uint64_t i = 0; i < n_lines; i++)
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9UL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebUL;
+	return (z ^ (z >> 31));
+}
+
+// Uniform in [0, bound), rejecting draws from the incomplete top interval
+t_u128	random_below(uint64_t *state, t_u128 bound)
+{
+	t_u128	limit = ~(t_u128)0 - (~(t_u128)0 % bound);
+	t_u128	draw;
+
+	do
+		draw = ((t_u128)splitmix64(state) << 64) | splitmix64(state);
+	while (draw >= limit);
+	return (draw % bound);
+}
+
+int	show_timelines(FILE *fp, bool have_index, t_u128 index, uint64_t n_samples, uint64_t seed)
+{
+	uint64_t	n_lines;
+	char		**lines = read_lines(fp, &n_lines);
+
+	if (n_lines == 0)
+		return (free(lines), printf("Empty file\n"), 1);
+
+	struct timeline_table	table = build_timeline_table(lines, n_lines);
+	uint64_t				*pos_arr = malloc(n_lines * sizeof(uint64_t));
+	int						status = 0;
+	char					buf[40];
+
+	if (table.overflow)
+		status = (printf("Too many timelines to index in 128 bits\n"), 1);
+	else if (have_index && index >= table.total)
+		status = (printf("Index out of range, there are %s timelines\n", format_u128(table.total, buf)), 1);
+	else if (table.total == 0 && n_samples != 0)
+		status = (printf("No timelines to sample\n"), 1);
+	else
+	{
+		if (have_index)
+		{
+			nth_timeline(&table, index, pos_arr);
+			print_path(STDOUT_FILENO, lines, pos_arr, n_lines, index);
+		}
+		for (uint64_t i = 0; i < n_samples; i++)
+		{
+			t_u128	k = random_below(&seed, table.total);
+			nth_timeline(&table, k, pos_arr);
+			print_path(STDOUT_FILENO, lines, pos_arr, n_lines, k);
+		}
+	}
+	free(pos_arr);
+	free(table.suffix);
+	free_ptr_array((void **)lines, n_lines);
+	return (status);
+}
+
+// Each row's splitters as column lists in one flat array (CSR), since a row
+// only changes counts at its splitters. Rows are cut to the first row's width.
+struct splitter_rows
+{
+	uint64_t	*cols;
+	uint64_t	*row_start;
+	uint64_t	n_rows;
+	uint64_t	n_splitters;
+	uint64_t	width;
+};
+
+struct splitter_rows	read_splitter_rows(FILE *fp)
+{
+	struct splitter_rows	rows = {0};
+	uint64_t				rows_size = 256;
+	uint64_t				cols_size = 256;
+	char					*line = NULL;
+	uint64_t				size = 0;
+
+	rows.row_start = malloc(rows_size * sizeof(uint64_t));
+	rows.cols = malloc(cols_size * sizeof(uint64_t));
+	rows.row_start[0] = 0;
+	while (getline(&line, &size, fp) != -1)
 	{
-		converted[i] = calloc(strlen(lines[i]), sizeof(uint64_t));
-		for (uint64_t j = 0; lines[i][j] != 0; j++)
-		{
-			switch (lines[i][j]) {
-				case ('.'):
-					converted[i][j] = 0;
-					break ;
-				case ('S'):
-					converted[i][j] = 1;
-					break ;
-				case ('^'):
-					converted[i][j] = -1;
-					break ;
-				default:
-					printf("invalid character!\n");
-					exit(1);
+		trim_nl(line);
+		if (rows.n_rows == 0)
+			rows.width = strlen(line);
+		if (rows.n_rows + 2 > rows_size)
+		{
+			rows_size *= 2;
+			rows.row_start = realloc(rows.row_start, rows_size * sizeof(uint64_t));
+		}
+
+		const char	*end = line + strnlen(line, rows.width);
+		for (const char *p = line; (p = memchr(p, '^', end - p)) != NULL; p++)
+		{
+			if (rows.n_splitters == cols_size)
+			{
+				cols_size *= 2;
+				rows.cols = realloc(rows.cols, cols_size * sizeof(uint64_t));
 			}
+			rows.cols[rows.n_splitters++] = p - line;
+		}
+		rows.row_start[++rows.n_rows] = rows.n_splitters;
+	}
+	free(line);
+	return (rows);
+}
+
+void	free_splitter_rows(struct splitter_rows *rows)
+{
+	free(rows->cols);
+	free(rows->row_start);
+}
+
+// Beam counts after the last row are a linear map M of the counts entering
+// the top, so 1ᵀM gives the timelines from every entry column at once.
+// Pulling the all-ones vector back through one row only changes its
+// splitter columns, each taking the values of the cells it sheds into;
+// those are never splitters themselves, so it works in place in O(splitters).
+t_u128	*entry_timelines(struct splitter_rows *rows, uint64_t modulus, bool *overflow)
+{
+	t_u128		*counts = malloc(rows->width * sizeof(t_u128));
+	bool		*is_splitter = calloc(rows->width + 2, sizeof(bool)) + 1;
+
+	for (uint64_t c = 0; c < rows->width; c++)
+		counts[c] = 1;
+	// Outside the field counts as a splitter so beams leaving it are lost
+	is_splitter[-1] = is_splitter[rows->width] = true;
+	for (uint64_t r = rows->n_rows; r-- > 0; )
+	{
+		const uint64_t	*first = rows->cols + rows->row_start[r];
+		const uint64_t	*last = rows->cols + rows->row_start[r + 1];
+
+		for (const uint64_t *col = first; col < last; col++)
+			is_splitter[*col] = true;
+		for (const uint64_t *col = first; col < last; col++)
+		{
+			uint64_t	c = *col;
+			t_u128		left = is_splitter[c - 1] ? 0 : counts[c - 1];
+			t_u128		right = is_splitter[c + 1] ? 0 : counts[c + 1];
+
+			*overflow |= __builtin_add_overflow(left, right, &counts[c]);
+			if (modulus != 0)
+				counts[c] %= modulus;
 		}
+		for (const uint64_t *col = first; col < last; col++)
+			is_splitter[*col] = false;
 	}
-	return (converted);
+	free(is_splitter - 1);
+	return (counts);
+}
+
+struct entry
+{
+	t_u128		count;
+	uint64_t	col;
+};
+
+int	cmp_entry_desc(const void *a, const void *b)
+{
+	const struct entry	*ea = a;
+	const struct entry	*eb = b;
+
+	if (ea->count != eb->count)
+		return (ea->count < eb->count ? 1 : -1);
+	return (ea->col > eb->col ? 1 : -1);
+}
+
+// Prints the n_report entry columns with the most timelines
+int	report_entries(FILE *fp, uint64_t modulus, uint64_t n_report)
+{
+	struct splitter_rows	rows = read_splitter_rows(fp);
+
+	if (rows.n_rows == 0)
+		return (free_splitter_rows(&rows), printf("Empty file\n"), 1);
+
+	bool		overflow = false;
+	t_u128		*counts = entry_timelines(&rows, modulus, &overflow);
+	struct entry	*order = malloc(rows.width * sizeof(struct entry));
+	char			buf[40];
+
+	for (uint64_t c = 0; c < rows.width; c++)
+		order[c] = (struct entry){.count = counts[c], .col = c};
+	qsort(order, rows.width, sizeof(struct entry), cmp_entry_desc);
+	printf("rows: %lu  splitters: %lu\n", rows.n_rows, rows.n_splitters);
+	if (overflow)
+	{
+		// Wrapped counts would rank the columns arbitrarily
+		printf("timeline counts overflowed 128 bits, use --mod p\n");
+		n_report = 0;
+	}
+	if (n_report > rows.width)
+		n_report = rows.width;
+	for (uint64_t i = 0; i < n_report; i++)
+	{
+		printf("column %lu: %s", order[i].col, format_u128(order[i].count, buf));
+		if (modulus != 0)
+			printf(" (mod %lu)", modulus);
+		printf("\n");
+	}
+	free(order);
+	free(counts);
+	free_splitter_rows(&rows);
+	return (overflow);
 }
 
 int	main(int argc, char **argv)
 {
-	if (argc != 2)
+	char		*path = NULL;
+	uint64_t	modulus = 0;
+	char		*endptr;
+	bool		have_index = false;
+	t_u128		index = 0;
+	uint64_t	n_samples = 0;
+	uint64_t	seed = time(NULL);
+	uint64_t	n_entries = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--mod") == 0 && i + 1 < argc)
+		{
+			errno = 0;
+			modulus = strtoul(argv[++i], &endptr, 10);
+			if (*endptr != '\0' || errno != 0 || modulus < 2 || modulus > MAX_MODULUS)
+				return (printf("Error parsing modulus (2-2^62)\n"), 1);
+		}
+		else if (strcmp(argv[i], "--path") == 0 && i + 1 < argc)
+		{
+			if (!parse_u128(argv[++i], &index))
+				return (printf("Error parsing timeline index\n"), 1);
+			have_index = true;
+		}
+		else if (strcmp(argv[i], "--sample") == 0 && i + 1 < argc)
+		{
+			errno = 0;
+			n_samples = strtoul(argv[++i], &endptr, 10);
+			if (*endptr != '\0' || errno != 0)
+				return (printf("Error parsing sample count\n"), 1);
+		}
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+		{
+			errno = 0;
+			seed = strtoul(argv[++i], &endptr, 10);
+			if (*endptr != '\0' || errno != 0)
+				return (printf("Error parsing seed\n"), 1);
+		}
+		else if (strcmp(argv[i], "--entries") == 0 && i + 1 < argc)
+		{
+			errno = 0;
+			n_entries = strtoul(argv[++i], &endptr, 10);
+			if (*endptr != '\0' || errno != 0 || n_entries == 0)
+				return (printf("Error parsing entry count\n"), 1);
+		}
+		else if (path == NULL)
+			path = argv[i];
+		else
+			return (printf("Usage: %s <file> [--mod p] [--path k] [--sample n [--seed s]] [--entries n]\n", argv[0]), 1);
+	}
+	if (path == NULL)
 		return (printf("No file provided\n"), 1);
 
-	FILE *fp = fopen(argv[1], "r");
+	FILE *fp = fopen(path, "r");
 	if (fp == NULL)
 		return (printf("Failed to open file\n"), 1);
+	if (n_entries != 0)
+	{
+		int	status = report_entries(fp, modulus, n_entries);
+		return (fclose(fp), status);
+	}
+	if (have_index || n_samples != 0)
+	{
+		if (modulus != 0)
+			return (fclose(fp), printf("--mod cannot be combined with --path or --sample\n"), 1);
+		int	status = show_timelines(fp, have_index, index, n_samples, seed);
+		return (fclose(fp), status);
+	}
 
-	char		**lines = NULL;
-	uint64_t	n_lines = 0;
-
-	lines = read_lines(fp, &n_lines);
-	fclose(fp);
-
+	char		*line = NULL;
+	uint64_t	size = 0;
+	int64_t		len = getline(&line, &size, fp);
 
-	int64_t		**arr = convert_lines(lines, n_lines);
-	uint64_t	linelen = strlen(lines[0]);
+	if (len == -1)
+		return (fclose(fp), free(line), printf("Empty file\n"), 1);
 
-	for (uint64_t i = 0; i < n_lines - 1; i++)
-		process_converted_line(arr, i, linelen);
+	// Only the current and next rows of beam counts are ever resident, sized
+	// from the first trimmed line
+	struct beam_rows	rows = {};
+	uint64_t			n_splits = 0;
 
-	uint64_t	total_paths = 0;
-	for (uint64_t i = 0; i < linelen; i++)
-		total_paths += arr[n_lines - 1][i];
-	printf("total: %lu\n", total_paths);
+	do
+	{
+		trim_nl(line);
+		if (rows.cur == NULL)
+			rows = new_beam_rows(strlen(line), modulus);
+		load_row(&rows, line);
+		n_splits += propagate_row(&rows);
+	} while (getline(&line, &size, fp) != -1);
+	fclose(fp);
 
-	// uint64_t	start_pos = strchr(lines[0], 'S') - lines[0];
-	// int logfd = open("./log.txt", O_CREAT | O_WRONLY | O_TRUNC, S_IWUSR | S_IRUSR | S_IRGRP | S_IROTH);
-	//
-	// uint64_t	total = 0;
-	// struct data	data = {.lines = lines, .n_lines = n_lines, .logfd = logfd, .n_paths = total};
-	// gettimeofday(&data.start, NULL);
-	// follow_path(&data, start_pos, 0);
+	t_u128	total_paths = 0;
+	for (uint64_t i = 0; i < rows.width; i++)
+	{
+		if (rows.wide)
+			total_paths += rows.cur_wide[i];
+		else if (modulus != 0)
+			total_paths = add_mod(total_paths, rows.cur[i], modulus);
+		else
+			total_paths += rows.cur[i];
+	}
+	printf("splits: %lu\n", n_splits);
+	// The wrapped value means nothing, so only the overflow is reported
+	int		status = rows.overflow;
+	char	buf[40];
+	if (rows.overflow)
+		printf("total: overflowed 128 bits, use --mod p\n");
+	else
+	{
+		printf("total: %s", format_u128(total_paths, buf));
+		if (modulus != 0)
+			printf(" (mod %lu)", modulus);
+		printf("\n");
+	}
 
-	free_ptr_array((void **)lines, n_lines);
-	free_ptr_array((void **)arr, n_lines);
-	// close(logfd);
+	free(line);
+	free_beam_rows(&rows);
+	return (status);
 }
@@ -5,16 +5,9 @@
 #include <string.h>
 #include <fcntl.h>
 #include <stdbool.h>
-#include <math.h>
 
 uint64_t	max_conns;
 
-enum {
-	PRE_ORD,
-	IN_ORD,
-	POST_ORD,
-};
-
 typedef struct vec3
 {
 	int64_t	x;
@@ -22,35 +15,56 @@ typedef struct vec3
 	int64_t	z;
 }	t_vec3;
 
-typedef struct dist_node
+// Coordinates are limited to +-2^30 so a squared distance fits in 64 bits
+#define MAX_COORD (1L << 30)
+
+// A connection between vecs[i] and vecs[j] (i < j), keyed on the exact
+// squared distance
+struct edge
 {
-	double				distance;
-	t_vec3				*pos1;
-	t_vec3				*pos2;
-	struct dist_node	*left;
-	struct dist_node	*right;
-	struct dist_node	*next;
-}	t_distnode;
+	uint64_t	dist;
+	uint32_t	i;
+	uint32_t	j;
+};
+
+#define KD_LEAF_SIZE 8
 
-struct adjlist
+// Node of a k-d tree over a permuted copy of the vecs. Each node keeps the
+// bounding box of its points, children split them at the median of the
+// widest axis and leaves (left == 0) hold at most KD_LEAF_SIZE points, so
+// there are fewer than n / 2 nodes.
+struct kd_node
 {
-	uint64_t		vert_idx;
-	struct adjlist	*next;
+	t_vec3		min;
+	t_vec3		max;
+	uint32_t	begin;
+	uint32_t	end;
+	uint32_t	left;
+	uint32_t	right;
 };
 
-struct graph
+struct kd_tree
 {
-	uint64_t		n_vertices;
-	struct adjlist	**vertices;
-	uint8_t			*visited;
+	struct kd_node	*nodes;
+	uint64_t		n_nodes;
+	t_vec3			*pts;
+	uint32_t		*ids;
 };
 
-struct graphbuilder
+// Max-heap holding the closest edges seen so far, at most cap of them
+struct edge_heap
 {
-	struct graph	*graph;
-	t_vec3			*vecs;
-	uint64_t		n_edges;
-	uint64_t		answer_p2;
+	struct edge	*edges;
+	uint64_t	size;
+	uint64_t	cap;
+};
+
+// Union-find over the junction boxes; each set is one circuit
+struct circuits
+{
+	uint32_t	*parent;
+	uint32_t	*size;
+	uint64_t	n_components;
 };
 
 void	trim_nl(char *line)
@@ -109,215 +123,579 @@ t_vec3	*get_vecs(char **lines, uint64_t n_lines)
 		vecs[i].z = strtol(endptr + 1, &endptr, 10);
 		if (errno != 0 || *endptr != '\0')
 			return (free(vecs), NULL);
+		if (llabs(vecs[i].x) >= MAX_COORD || llabs(vecs[i].y) >= MAX_COORD || llabs(vecs[i].z) >= MAX_COORD)
+			return (free(vecs), NULL);
 		// printf("(%6lu,%6lu,%6lu)\n", vecs[i].x, vecs[i].y, vecs[i].z);
 	}
 	return (vecs);
 }
 
-double	calculate_distance(t_vec3 *vec1, t_vec3 *vec2)
+uint64_t	calculate_distance(t_vec3 *vec1, t_vec3 *vec2)
 {
-	double	result;
+	int64_t	x_diff = vec1->x - vec2->x;
+	int64_t	y_diff = vec1->y - vec2->y;
+	int64_t	z_diff = vec1->z - vec2->z;
 
-	double x_diff = (vec1->x - vec2->x);
-	double y_diff = (vec1->y - vec2->y);
-	double z_diff = (vec1->z - vec2->z);
-
-	result = sqrt((x_diff * x_diff) + (y_diff * y_diff) + (z_diff * z_diff));
-
-	return (result);
+	return ((uint64_t)(x_diff * x_diff) + (uint64_t)(y_diff * y_diff) + (uint64_t)(z_diff * z_diff));
 }
 
-t_distnode	*new_distnode(t_vec3 *vec1, t_vec3 *vec2)
+void	print_edge(struct edge *edge, t_vec3 *vecs)
 {
-	t_distnode	*new = malloc(sizeof(*new));
-
-	new->distance = calculate_distance(vec1, vec2);
-	new->pos1 = vec1;
-	new->pos2 = vec2;
-	new->next = NULL;
-	new->left = NULL;
-	new->right = NULL;
+	t_vec3	*vec1 = &vecs[edge->i];
+	t_vec3	*vec2 = &vecs[edge->j];
+	printf("(%6lu,%6lu,%6lu)\t(%6lu,%6lu,%6lu)\t%lu\n",
+		vec1->x, vec1->y, vec1->z,
+		vec2->x, vec2->y, vec2->z,
+		edge->dist);
+}
 
-	return (new);
+uint64_t	edge_key(struct edge *edge, bool by_pair)
+{
+	return (by_pair ? (uint64_t)edge->i << 32 | edge->j : edge->dist);
 }
 
-void	dist_tree_insert(t_distnode **root, t_distnode *node)
+// LSD radix sort on dist, or on (i, j) with by_pair, one byte per pass.
+// Passes where every key shares the same byte are skipped, and being stable
+// it keeps equal distances in their existing order.
+void	radix_sort_edges(struct edge *edges, uint64_t n_edges, bool by_pair)
 {
-	if (root == NULL || node == NULL)
+	uint64_t	counts[8][256] = {};
+	struct edge	*tmp = malloc(n_edges * sizeof(struct edge));
+	struct edge	*src = edges;
+	struct edge	*dst = tmp;
+
+	if (n_edges == 0)
+		return (free(tmp));
+	for (uint64_t i = 0; i < n_edges; i++)
 	{
-		printf("Error!\n");
-		exit(1);
+		for (int32_t pass = 0; pass < 8; pass++)
+			counts[pass][(edge_key(&edges[i], by_pair) >> (pass * 8)) & 0xff]++;
 	}
 
-	if (*root == NULL)
+	for (int32_t pass = 0; pass < 8; pass++)
 	{
-		*root = node;
-		return ;
-	}
+		uint64_t	offset = 0;
+		int32_t		shift = pass * 8;
 
-	t_distnode	**addr;
-	t_distnode	*curr = *root;
-	while (curr != NULL)
-	{
-		if (node->distance < curr->distance)
-			addr = &curr->left;
-		else
-			addr = &curr->right;
-		curr = *addr;
+		if (counts[pass][(edge_key(&edges[0], by_pair) >> shift) & 0xff] == n_edges)
+			continue ;
+		for (int32_t i = 0; i < 256; i++)
+		{
+			uint64_t	count = counts[pass][i];
+			counts[pass][i] = offset;
+			offset += count;
+		}
+		for (uint64_t i = 0; i < n_edges; i++)
+			dst[counts[pass][(edge_key(&src[i], by_pair) >> shift) & 0xff]++] = src[i];
+
+		struct edge	*swap = src;
+		src = dst;
+		dst = swap;
 	}
-	*addr = node;
+
+	if (src != edges)
+		memcpy(edges, src, n_edges * sizeof(struct edge));
+	free(tmp);
 }
 
-void	print_distnode(t_distnode *node, void *null)
+int64_t	vec_axis(t_vec3 *vec, int32_t axis)
 {
-	t_vec3	*vec1 = node->pos1;
-	t_vec3	*vec2 = node->pos2;
-	printf("(%6lu,%6lu,%6lu)\t(%6lu,%6lu,%6lu)\t%f\n",
-		vec1->x, vec1->y, vec1->z,
-		vec2->x, vec2->y, vec2->z,
-		node->distance);
-	(void)null;
+	return (axis == 0 ? vec->x : axis == 1 ? vec->y : vec->z);
 }
 
-t_distnode *build_dist_tree(t_vec3 *vecs, uint64_t n_lines, uint64_t *n_links)
+void	swap_points(t_vec3 *pts, uint32_t *ids, uint64_t a, uint64_t b)
 {
-	t_distnode	*dist_tree = NULL;
-	t_distnode	*new = NULL;
-	uint64_t	n = 0;
+	t_vec3		swap_pt = pts[a];
+	uint32_t	swap_id = ids[a];
 
-	for (uint64_t i = 0; i < n_lines; i++)
+	pts[a] = pts[b];
+	ids[a] = ids[b];
+	pts[b] = swap_pt;
+	ids[b] = swap_id;
+}
+
+// Quickselect on the axis coordinate so that pts[mid] has its sorted value,
+// with smaller-or-equal points before it and larger-or-equal after
+void	select_median(t_vec3 *pts, uint32_t *ids, uint64_t lo, uint64_t hi, uint64_t mid, int32_t axis)
+{
+	while (hi - lo > 1)
 	{
-		for (uint64_t j = n_lines - 1; j > i; j--)
+		int64_t		pivot = vec_axis(&pts[lo + (hi - lo) / 2], axis);
+		uint64_t	i = lo;
+		uint64_t	lt = lo;
+		uint64_t	gt = hi;
+
+		// Three-way partition into < pivot, == pivot, > pivot
+		while (i < gt)
 		{
-			new = new_distnode(&vecs[i], &vecs[j]);
-			// print_distnode(new, NULL);
-			n++;
-			dist_tree_insert(&dist_tree, new);
+			int64_t	value = vec_axis(&pts[i], axis);
+
+			if (value < pivot)
+				swap_points(pts, ids, i++, lt++);
+			else if (value > pivot)
+				swap_points(pts, ids, i, --gt);
+			else
+				i++;
 		}
+		if (mid < lt)
+			hi = lt;
+		else if (mid >= gt)
+			lo = gt;
+		else
+			return ;
 	}
-
-	*n_links = n;
-	return (dist_tree);
 }
 
-void	traverse_dist_tree(t_distnode *node, int order,
-			void (*f)(t_distnode *, void *), void *data)
+uint32_t	build_kd_node(struct kd_tree *tree, uint32_t begin, uint32_t end)
 {
-	if (node == NULL)
-		return ;
+	uint32_t		idx = tree->n_nodes++;
+	struct kd_node	*node = &tree->nodes[idx];
+
+	node->begin = begin;
+	node->end = end;
+	node->left = node->right = 0;
+	node->min = node->max = tree->pts[begin];
+	for (uint32_t i = begin + 1; i < end; i++)
+	{
+		t_vec3	*pt = &tree->pts[i];
+
+		node->min = (t_vec3){pt->x < node->min.x ? pt->x : node->min.x,
+			pt->y < node->min.y ? pt->y : node->min.y, pt->z < node->min.z ? pt->z : node->min.z};
+		node->max = (t_vec3){pt->x > node->max.x ? pt->x : node->max.x,
+			pt->y > node->max.y ? pt->y : node->max.y, pt->z > node->max.z ? pt->z : node->max.z};
+	}
+	if (end - begin <= KD_LEAF_SIZE)
+		return (idx);
+
+	int32_t		axis = 0;
+	int64_t		widest = node->max.x - node->min.x;
+	uint32_t	mid = begin + (end - begin) / 2;
 
-	if (order == PRE_ORD)
-		f(node, data);
-	traverse_dist_tree(node->left, order, f, data);
-	if (order == IN_ORD)
-		f(node, data);
-	traverse_dist_tree(node->right, order, f, data);
-	if (order == POST_ORD)
-		f(node, data);
+	if (node->max.y - node->min.y > widest)
+	{
+		axis = 1;
+		widest = node->max.y - node->min.y;
+	}
+	if (node->max.z - node->min.z > widest)
+		axis = 2;
+	select_median(tree->pts, tree->ids, begin, end, mid, axis);
+	node->left = build_kd_node(tree, begin, mid);
+	node->right = build_kd_node(tree, mid, end);
+	return (idx);
 }
 
-struct adjlist	*new_adjnode(uint64_t vertex)
+struct kd_tree	build_kd_tree(t_vec3 *vecs, uint64_t n_vecs)
 {
-	struct adjlist	*new = malloc(sizeof(struct adjlist));
+	struct kd_tree	tree = {
+		.nodes = malloc((2 * (n_vecs / (KD_LEAF_SIZE / 2) + 1)) * sizeof(struct kd_node)),
+		.pts = malloc(n_vecs * sizeof(t_vec3)),
+		.ids = malloc(n_vecs * sizeof(uint32_t)),
+	};
 
-	new->vert_idx = vertex;
-	new->next = NULL;
-	return (new);
+	memcpy(tree.pts, vecs, n_vecs * sizeof(t_vec3));
+	for (uint64_t i = 0; i < n_vecs; i++)
+		tree.ids[i] = i;
+	if (n_vecs != 0)
+		build_kd_node(&tree, 0, n_vecs);
+	return (tree);
 }
 
-void	add_to_adjlist(struct adjlist **list, struct adjlist *node)
+void	free_kd_tree(struct kd_tree *tree)
 {
-	if (list == NULL)
-		return ;
+	free(tree->nodes);
+	free(tree->pts);
+	free(tree->ids);
+}
 
-	node->next = *list;
-	*list = node;
+int64_t	axis_gap(int64_t value, int64_t lo, int64_t hi)
+{
+	return (value < lo ? lo - value : value > hi ? value - hi : 0);
 }
 
-void	add_graph_edge(struct graph *graph, uint64_t src, uint64_t dst)
+// Squared distance from vec to the nearest point of the node's box
+uint64_t	box_distance(struct kd_node *node, t_vec3 *vec)
 {
-	struct adjlist	*new = new_adjnode(dst);
-	new->next = graph->vertices[src];
-	add_to_adjlist(&graph->vertices[src], new);
+	int64_t	x_gap = axis_gap(vec->x, node->min.x, node->max.x);
+	int64_t	y_gap = axis_gap(vec->y, node->min.y, node->max.y);
+	int64_t	z_gap = axis_gap(vec->z, node->min.z, node->max.z);
 
-	new = new_adjnode(src);
-	new->next = graph->vertices[dst];
-	add_to_adjlist(&graph->vertices[dst], new);
+	return ((uint64_t)(x_gap * x_gap) + (uint64_t)(y_gap * y_gap) + (uint64_t)(z_gap * z_gap));
 }
 
-void	add_edge_from_distnode(t_distnode *dist_node, void *graph_builder)
+// Orders edges by (dist, i, j), matching the stable sort of all pairs
+bool	edge_less(struct edge *a, struct edge *b)
 {
-	struct graphbuilder *gbuilder = graph_builder;
-	if (gbuilder->n_edges >= max_conns)
+	if (a->dist != b->dist)
+		return (a->dist < b->dist);
+	if (a->i != b->i)
+		return (a->i < b->i);
+	return (a->j < b->j);
+}
+
+// Adds edge if the heap has room or it beats the current worst edge
+void	heap_offer(struct edge_heap *heap, struct edge edge)
+{
+	struct edge	*edges = heap->edges;
+	uint64_t	i;
+
+	if (heap->size < heap->cap)
+	{
+		i = heap->size++;
+		while (i > 0 && edge_less(&edges[(i - 1) / 2], &edge))
+		{
+			edges[i] = edges[(i - 1) / 2];
+			i = (i - 1) / 2;
+		}
+		edges[i] = edge;
+		return ;
+	}
+	if (heap->cap == 0 || !edge_less(&edge, &edges[0]))
 		return ;
+	i = 0;
+	while (2 * i + 1 < heap->size)
+	{
+		uint64_t	child = 2 * i + 1;
+
+		if (child + 1 < heap->size && edge_less(&edges[child], &edges[child + 1]))
+			child++;
+		if (!edge_less(&edge, &edges[child]))
+			break ;
+		edges[i] = edges[child];
+		i = child;
+	}
+	edges[i] = edge;
+}
+
+// Distance a candidate must not exceed: the worst kept edge once the heap
+// is full, otherwise the bound from the leaf-local estimate
+uint64_t	heap_bound(struct edge_heap *heap, uint64_t bound)
+{
+	if (heap->size == heap->cap && heap->edges[0].dist < bound)
+		return (heap->edges[0].dist);
+	return (bound);
+}
+
+// Offers every pair of the point at pos with a point after it in tree
+// order that could still make the cut. Subtrees wholly before pos are
+// skipped, so each pair is looked at from one side only.
+void	query_closest(struct kd_tree *tree, struct edge_heap *heap, uint32_t pos, uint64_t bound)
+{
+	struct
+	{
+		uint32_t	node;
+		uint64_t	dist;
+	}			stack[64];
+	int32_t		top = 0;
+	t_vec3		*vec = &tree->pts[pos];
+	uint32_t	id = tree->ids[pos];
+
+	stack[top++].node = 0;
+	stack[0].dist = 0;
+	while (top > 0)
+	{
+		top--;
+
+		struct kd_node	*node = &tree->nodes[stack[top].node];
 
-	uint64_t	src = dist_node->pos1 - gbuilder->vecs;
-	uint64_t	dst = dist_node->pos2 - gbuilder->vecs;
+		if (node->end <= pos + 1 || stack[top].dist > heap_bound(heap, bound))
+			continue ;
+		if (node->left == 0)
+		{
+			for (uint32_t k = node->begin > pos ? node->begin : pos + 1; k < node->end; k++)
+			{
+				uint64_t	dist = calculate_distance(vec, &tree->pts[k]);
+
+				if (dist <= heap_bound(heap, bound))
+					heap_offer(heap, (struct edge){dist, id < tree->ids[k] ? id : tree->ids[k],
+						id < tree->ids[k] ? tree->ids[k] : id});
+			}
+			continue ;
+		}
+		// Push the far child first so the near one is searched first
+		uint64_t	left_dist = box_distance(&tree->nodes[node->left], vec);
+		uint64_t	right_dist = box_distance(&tree->nodes[node->right], vec);
+		bool		left_near = left_dist <= right_dist;
+
+		stack[top].node = left_near ? node->right : node->left;
+		stack[top++].dist = left_near ? right_dist : left_dist;
+		stack[top].node = left_near ? node->left : node->right;
+		stack[top++].dist = left_near ? left_dist : right_dist;
+	}
+}
+
+// The k closest pairs in (dist, i, j) order, without materialising all of
+// them: a k-d tree query per point feeds a bounded max-heap, so memory is
+// O(n + k). Pairs within subtrees of about 4k / n points first give an
+// upper bound on the k-th distance, which prunes the queries before the
+// heap fills.
+struct edge	*closest_pairs(t_vec3 *vecs, uint64_t n_vecs, uint64_t k, uint64_t *n_edges)
+{
+	struct kd_tree		tree = build_kd_tree(vecs, n_vecs);
+	uint64_t			n_pairs = n_vecs < 2 ? 0 : n_vecs * (n_vecs - 1) / 2;
+	struct edge_heap	heap = {.cap = k < n_pairs ? k : n_pairs};
+	uint64_t			bound = UINT64_MAX;
+
+	uint64_t			seed_size = KD_LEAF_SIZE + (n_vecs != 0 ? 4 * heap.cap / n_vecs : 0);
+	uint32_t			stack[64];
+	int32_t				top = 0;
+
+	heap.edges = malloc((heap.cap + 1) * sizeof(struct edge));
+	if (tree.n_nodes != 0)
+		stack[top++] = 0;
+	while (top > 0)
+	{
+		struct kd_node	*node = &tree.nodes[stack[--top]];
 
-	add_graph_edge(gbuilder->graph, src, dst);
-	gbuilder->n_edges++;
+		if (node->end - node->begin > seed_size)
+		{
+			stack[top++] = node->left;
+			stack[top++] = node->right;
+			continue ;
+		}
+		for (uint32_t a = node->begin; a < node->end; a++)
+		{
+			for (uint32_t b = a + 1; b < node->end; b++)
+			{
+				uint32_t	i = tree.ids[a] < tree.ids[b] ? tree.ids[a] : tree.ids[b];
+				uint32_t	j = tree.ids[a] ^ tree.ids[b] ^ i;
+				heap_offer(&heap, (struct edge){calculate_distance(&tree.pts[a], &tree.pts[b]), i, j});
+			}
+		}
+	}
+	if (heap.size == heap.cap && heap.size != 0)
+		bound = heap.edges[0].dist;
+
+	heap.size = 0;
+	for (uint64_t pos = 0; pos < n_vecs && heap.cap != 0; pos++)
+		query_closest(&tree, &heap, pos, bound);
+	free_kd_tree(&tree);
+
+	// Heap order breaks ties arbitrarily, so sort on (i, j) first
+	radix_sort_edges(heap.edges, heap.size, true);
+	radix_sort_edges(heap.edges, heap.size, false);
+	*n_edges = heap.size;
+	return (heap.edges);
 }
 
-uint64_t	get_component_size(struct graph *graph, uint64_t vertex)
+struct circuits	new_circuits(uint64_t n_vecs)
 {
-	uint64_t		size = 1;
-	struct adjlist	*curr;
+	struct circuits	circuits = {
+		.parent = malloc(n_vecs * sizeof(uint32_t)),
+		.size = malloc(n_vecs * sizeof(uint32_t)),
+		.n_components = n_vecs,
+	};
 
-	graph->visited[vertex] = 1;
-	curr = graph->vertices[vertex];
-	while (curr != NULL)
+	for (uint64_t i = 0; i < n_vecs; i++)
 	{
-		if (graph->visited[curr->vert_idx] == 0)
-			size += get_component_size(graph, curr->vert_idx);
-		curr = curr->next;
+		circuits.parent[i] = i;
+		circuits.size[i] = 1;
 	}
+	return (circuits);
+}
 
-	return (size);
+void	free_circuits(struct circuits *circuits)
+{
+	free(circuits->parent);
+	free(circuits->size);
 }
 
-void	find_final_connection(t_distnode *dist_node, void *graph_builder)
+// Path halving: every other node on the way up is pointed at its grandparent
+uint32_t	find_circuit(struct circuits *circuits, uint32_t vec)
 {
-	struct graphbuilder *gbuilder = graph_builder;
-	uint64_t			src = dist_node->pos1 - gbuilder->vecs;
-	uint64_t			dst = dist_node->pos2 - gbuilder->vecs;
+	uint32_t	*parent = circuits->parent;
 
-	if (gbuilder->answer_p2 != 0)
-		return ;
+	while (parent[vec] != vec)
+	{
+		parent[vec] = parent[parent[vec]];
+		vec = parent[vec];
+	}
+	return (vec);
+}
 
-	add_graph_edge(gbuilder->graph, src, dst);
+// Joins the circuits of src and dst, smaller under larger. Returns false if
+// they were already connected.
+bool	connect(struct circuits *circuits, uint32_t src, uint32_t dst)
+{
+	src = find_circuit(circuits, src);
+	dst = find_circuit(circuits, dst);
+	if (src == dst)
+		return (false);
+	if (circuits->size[src] < circuits->size[dst])
+	{
+		uint32_t	swap = src;
+		src = dst;
+		dst = swap;
+	}
+	circuits->parent[dst] = src;
+	circuits->size[src] += circuits->size[dst];
+	circuits->n_components--;
+	return (true);
+}
 
-	memset(gbuilder->graph->visited, 0, gbuilder->graph->n_vertices);
-	uint64_t size = get_component_size(gbuilder->graph, 0);
-	// printf("component_size: %lu\n", size);
-	if (size == gbuilder->graph->n_vertices)
+void	get_biggest(struct circuits *circuits, uint64_t n_vecs, uint64_t biggest[3])
+{
+	biggest[0] = biggest[1] = biggest[2] = 0;
+	for (uint64_t i = 0; i < n_vecs; i++)
 	{
-		printf("edges required: %lu\n", gbuilder->n_edges);
-		print_distnode(dist_node, NULL);
-		gbuilder->answer_p2 = dist_node->pos1->x * dist_node->pos2->x;
+		if (circuits->parent[i] != i)
+			continue ;
+
+		uint64_t	size = circuits->size[i];
+		if (size > biggest[0])
+		{
+			biggest[2] = biggest[1];
+			biggest[1] = biggest[0];
+			biggest[0] = size;
+		}
+		else if (size > biggest[1])
+		{
+			biggest[2] = biggest[1];
+			biggest[1] = size;
+		}
+		else if (size > biggest[2])
+			biggest[2] = size;
 	}
-	gbuilder->n_edges++;
 }
 
-void	print_adjlist(struct graph *graph, t_vec3 *vecs)
+// Marks each node whose points all lie in one circuit with that circuit,
+// others with UINT32_MAX. Children always come after their parent.
+void	label_nodes(struct kd_tree *tree, uint32_t *pos_circuit, uint32_t *node_circuit)
 {
-	for (uint64_t i = 0; i < graph->n_vertices; i++)
+	for (uint64_t n = tree->n_nodes; n-- > 0; )
 	{
-		struct adjlist *curr = graph->vertices[i];
-		if (curr == NULL)
+		struct kd_node	*node = &tree->nodes[n];
+
+		if (node->left != 0)
+		{
+			uint32_t	left = node_circuit[node->left];
+			node_circuit[n] = left == node_circuit[node->right] ? left : UINT32_MAX;
+			continue ;
+		}
+		node_circuit[n] = pos_circuit[node->begin];
+		for (uint32_t k = node->begin + 1; k < node->end; k++)
+			if (pos_circuit[k] != node_circuit[n])
+				node_circuit[n] = UINT32_MAX;
+	}
+}
+
+// Improves *best with the closest edge from the point at pos to a point
+// outside its circuit, skipping subtrees inside the circuit or further away
+void	query_outgoing(struct kd_tree *tree, uint32_t *pos_circuit, uint32_t *node_circuit,
+			uint32_t pos, struct edge *best)
+{
+	struct
+	{
+		uint32_t	node;
+		uint64_t	dist;
+	}			stack[64];
+	int32_t		top = 0;
+	t_vec3		*vec = &tree->pts[pos];
+	uint32_t	id = tree->ids[pos];
+	uint32_t	circuit = pos_circuit[pos];
+
+	stack[top++].node = 0;
+	stack[0].dist = 0;
+	while (top > 0)
+	{
+		top--;
+
+		struct kd_node	*node = &tree->nodes[stack[top].node];
+
+		if (node_circuit[stack[top].node] == circuit || stack[top].dist > best->dist)
 			continue ;
+		if (node->left == 0)
+		{
+			for (uint32_t k = node->begin; k < node->end; k++)
+			{
+				if (pos_circuit[k] == circuit)
+					continue ;
+
+				struct edge	edge = {calculate_distance(vec, &tree->pts[k]),
+					id < tree->ids[k] ? id : tree->ids[k], id < tree->ids[k] ? tree->ids[k] : id};
+				if (edge_less(&edge, best))
+					*best = edge;
+			}
+			continue ;
+		}
+		uint64_t	left_dist = box_distance(&tree->nodes[node->left], vec);
+		uint64_t	right_dist = box_distance(&tree->nodes[node->right], vec);
+		bool		left_near = left_dist <= right_dist;
+
+		stack[top].node = left_near ? node->right : node->left;
+		stack[top++].dist = left_near ? right_dist : left_dist;
+		stack[top].node = left_near ? node->left : node->right;
+		stack[top++].dist = left_near ? left_dist : right_dist;
+	}
+}
 
-		printf("Component %lu\n", i);
-		while (curr != NULL)
+// Euclidean minimum spanning tree by Boruvka rounds over the k-d tree: each
+// round every circuit finds its closest outgoing edge, from per-point
+// nearest-neighbour queries that skip subtrees already inside the circuit,
+// and all of them are joined. Edges compare on (dist, i, j), so the tree
+// is the one connecting the sorted pairs in order would build and its
+// largest edge is the final connection. Returns the n - 1 edges.
+struct edge	*euclidean_mst(t_vec3 *vecs, uint64_t n_vecs, uint64_t *n_edges)
+{
+	struct kd_tree	tree = build_kd_tree(vecs, n_vecs);
+	struct circuits	circuits = new_circuits(n_vecs);
+	struct edge		*mst = malloc((n_vecs + 1) * sizeof(struct edge));
+	struct edge		*best = malloc((n_vecs + 1) * sizeof(struct edge));
+	struct edge		*nearest = malloc((n_vecs + 1) * sizeof(struct edge));
+	uint32_t		*pos_circuit = malloc((n_vecs + 1) * sizeof(uint32_t));
+	uint32_t		*node_circuit = malloc((tree.n_nodes + 1) * sizeof(uint32_t));
+	uint64_t		*lower = calloc(n_vecs + 1, sizeof(uint64_t));
+	uint64_t		n = 0;
+
+	for (uint64_t pos = 0; pos < n_vecs; pos++)
+		nearest[pos] = (struct edge){UINT64_MAX, UINT32_MAX, UINT32_MAX};
+	while (n_vecs != 0 && circuits.n_components > 1)
+	{
+		for (uint64_t pos = 0; pos < n_vecs; pos++)
+		{
+			pos_circuit[pos] = find_circuit(&circuits, tree.ids[pos]);
+			best[pos_circuit[pos]] = (struct edge){UINT64_MAX, UINT32_MAX, UINT32_MAX};
+		}
+		label_nodes(&tree, pos_circuit, node_circuit);
+		for (uint64_t pos = 0; pos < n_vecs; pos++)
+		{
+			// Points outside the circuit only ever get fewer, so a point's
+			// nearest one from the last round still holds if it is outside,
+			// and its distance stays a lower bound if not. The circuit's best
+			// edge so far bounds a new query; if nothing beats it the point
+			// has no nearest to keep, only a higher lower bound.
+			struct edge	*best_edge = &best[pos_circuit[pos]];
+			uint32_t	other = nearest[pos].i ^ nearest[pos].j ^ tree.ids[pos];
+
+			if (lower[pos] > best_edge->dist)
+				continue ;
+			if (nearest[pos].dist == UINT64_MAX || find_circuit(&circuits, other) == pos_circuit[pos])
+			{
+				nearest[pos] = *best_edge;
+				query_outgoing(&tree, pos_circuit, node_circuit, pos, &nearest[pos]);
+				lower[pos] = nearest[pos].dist;
+				if (nearest[pos].i != tree.ids[pos] && nearest[pos].j != tree.ids[pos])
+					nearest[pos] = (struct edge){UINT64_MAX, UINT32_MAX, UINT32_MAX};
+			}
+			if (edge_less(&nearest[pos], best_edge))
+				*best_edge = nearest[pos];
+		}
+		for (uint64_t i = 0; i < n_vecs; i++)
 		{
-			printf("(%5lu,%5lu,%5lu)\n",
-				vecs[curr->vert_idx].x,
-				vecs[curr->vert_idx].y,
-				vecs[curr->vert_idx].z
-			);
-			curr = curr->next;
+			if (circuits.parent[i] == i && best[i].dist != UINT64_MAX
+				&& connect(&circuits, best[i].i, best[i].j))
+				mst[n++] = best[i];
 		}
-		printf("\n");
 	}
+	free(best);
+	free(nearest);
+	free(lower);
+	free(pos_circuit);
+	free(node_circuit);
+	free_circuits(&circuits);
+	free_kd_tree(&tree);
+
+	*n_edges = n;
+	return (mst);
 }
 
 int	main(int argc, char **argv)
@@ -348,57 +726,38 @@ int	main(int argc, char **argv)
 	if (vecs == NULL)
 		return (free_ptr_array((void **)lines, n_lines), printf("Error reading vecs\n"), 1);
 
-	uint64_t	n_links = 0;
-	t_distnode	*dist_tree = build_dist_tree(vecs, n_lines, &n_links);
-
-	traverse_dist_tree(dist_tree, IN_ORD, print_distnode, NULL);
-	printf("n_links: %lu\n\n", n_links);
-
-	struct graph graph = {
-		.n_vertices = n_lines,
-		.vertices = calloc(n_lines, sizeof(struct adjlist *)),
-		.visited = calloc(n_lines, sizeof(uint8_t)),
-	};
-
-	struct graphbuilder gbuilder = {
-		.graph = &graph,
-		.vecs = vecs,
-		.n_edges = 0,
-		.answer_p2 = 0,
-	};
-
-	// traverse_dist_tree(dist_tree, IN_ORD, add_edge_from_distnode, &gbuilder);
-	// print_adjlist(&graph, vecs);
-	// uint64_t	biggest[3] = {};
-	//
-	// for (uint64_t i = 0; i < graph.n_vertices; i++)
-	// {
-	// 	if (graph.visited[i] == 0)
-	// 	{
-	// 		uint64_t	size = get_component_size(&graph, i);
-	// 		printf("circuit size: %lu\n", size);
-	// 		if (size > biggest[0])
-	// 		{
-	// 			biggest[2] = biggest[1];
-	// 			biggest[1] = biggest[0];
-	// 			biggest[0] = size;
-	// 		}
-	// 		else if (size > biggest[1])
-	// 		{
-	// 			biggest[2] = biggest[1];
-	// 			biggest[1] = size;
-	// 		}
-	// 		else if (size > biggest[2])
-	// 			biggest[2] = size;
-	// 	}
-	// }
-	//
-	// printf("biggest: %lu %lu %lu\n", biggest[0], biggest[1], biggest[2]);
-	// total = biggest[0] * biggest[1] * biggest[2];
-
-	traverse_dist_tree(dist_tree, IN_ORD, find_final_connection, &gbuilder);
-	total = gbuilder.answer_p2;
-
+	// Part 1 only needs the circuits after the max_conns closest connections
+	uint64_t		n_closest = 0;
+	struct edge		*closest = closest_pairs(vecs, n_lines, max_conns, &n_closest);
+	struct circuits	circuits = new_circuits(n_lines);
+	uint64_t		biggest[3] = {};
+
+	for (uint64_t i = 0; i < n_closest; i++)
+		connect(&circuits, closest[i].i, closest[i].j);
+	get_biggest(&circuits, n_lines, biggest);
+	free_circuits(&circuits);
+	free(closest);
+
+	printf("biggest: %lu %lu %lu\n", biggest[0], biggest[1], biggest[2]);
+	printf("part 1: %lu\n", biggest[0] * biggest[1] * biggest[2]);
+
+	// Part 2 is the connection that leaves a single circuit, which is the
+	// longest edge of the minimum spanning tree
+	uint64_t	n_mst = 0;
+	struct edge	*mst = euclidean_mst(vecs, n_lines, &n_mst);
+	struct edge	*final = NULL;
+
+	for (uint64_t i = 0; i < n_mst; i++)
+		if (final == NULL || edge_less(final, &mst[i]))
+			final = &mst[i];
+	printf("mst edges: %lu\n", n_mst);
+	if (final != NULL)
+	{
+		print_edge(final, vecs);
+		total = vecs[final->i].x * vecs[final->j].x;
+	}
 	printf("total: %lu\n", total);
+	free(mst);
+	free(vecs);
 	free_ptr_array((void **)lines, n_lines);
 }